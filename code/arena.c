@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "header.h"
+
+/*necessary header files included*/
+
+#define ARENA_ALIGN 16
+/*every allocation starts on this boundary, enough for any basic type*/
+
+static ArenaBlock *newArenaBlock(size_t size)
+/*get a fresh block from the system, with size bytes of usable space*/
+{
+    ArenaBlock *block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + size);
+    if (block == NULL) {
+        printf("Memory Allocation Failed\n");
+        exit(1);
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void *arenaAlloc(Arena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    /*round the request up so the next allocation stays aligned*/
+    if (arena->blockSize == 0) {
+        arena->blockSize = ARENA_BLOCK_SIZE;
+    }
+    if (arena->current == NULL) {
+        arena->first = arena->current = newArenaBlock(size > arena->blockSize ? size : arena->blockSize);
+        /*the first allocation of the arena*/
+    }
+    while (arena->current->used + size > arena->current->size) {
+        ArenaBlock *next = arena->current->next;
+        if (next == NULL || next->size < size) {
+            ArenaBlock *block = newArenaBlock(size > arena->blockSize ? size : arena->blockSize);
+            block->next = next;
+            arena->current->next = block;
+            next = block;
+            /*insert a new block right after the current one, the old blocks behind are kept for reuse*/
+        }
+        next->used = 0;
+        /*blocks are emptied lazily when the arena moves onto them, that keeps arenaReset() O(1)*/
+        arena->current = next;
+    }
+    void *memory = arena->current->data + arena->current->used;
+    arena->current->used += size;
+    return memory;
+}
+
+void *arenaCalloc(Arena *arena, size_t count, size_t size)
+{
+    void *memory = arenaAlloc(arena, count * size);
+    memset(memory, 0, count * size);
+    /*the same as calloc, the memory is set to zero*/
+    return memory;
+}
+
+void arenaReset(Arena *arena)
+{
+    arena->current = arena->first;
+    if (arena->current != NULL) {
+        arena->current->used = 0;
+    }
+    /*everything allocated before is dropped at once, the blocks stay for the next expression*/
+}
+
+void arenaDestroy(Arena *arena)
+{
+    ArenaBlock *block = arena->first;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->first = arena->current = NULL;
+    /*give every block back to the system*/
+}
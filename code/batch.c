@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "header.h"
+
+/*necessary header files included*/
+
+#define BATCH_WINDOW 1024
+/*number of lines that are read and handed to the workers at a time*/
+
+typedef struct BatchJob {
+    char *line;
+    /*the line, in the buffer of the job or in place in the mapped file*/
+    size_t length;
+    /*number of characters of the line*/
+    char *text;
+    /*the buffer lines are read into with stdio*/
+    size_t capacity;
+    /*allocated length of text, kept from window to window*/
+    long lineNumber;
+    /*line number in the input, for the error report*/
+    OutputBuffer output;
+    /*the gradient block of the line, written out in input order*/
+    bool valid;
+    /*whether the line was a valid expression*/
+} BatchJob;
+
+typedef struct BatchWindow {
+    BatchJob jobs[BATCH_WINDOW];
+    int count;
+    /*number of lines read into the window*/
+    TaskGroup group;
+    /*the tasks of the window*/
+} BatchWindow;
+/*the lines of one window are worked on while the next window is being read*/
+
+typedef struct BatchInput {
+    FILE *file;
+    /*read with stdio, NULL for a mapped file*/
+    MappedFile *mapped;
+    /*the mapped file*/
+    size_t position;
+    /*offset of the next line in the mapped file*/
+} BatchInput;
+/*where the lines come from*/
+
+static bool nextLine(BatchInput *input, BatchJob *job)
+{
+    if (input->file != NULL) {
+        long length = readExpression(input->file, &job->text, &job->capacity);
+        job->line = job->text;
+        job->length = length < 0 ? 0 : (size_t)length;
+        return length >= 0;
+    }
+    MappedFile *mapped = input->mapped;
+    if (input->position >= mapped->length) {
+        return false;
+    }
+    char *start = mapped->data + input->position;
+    char *newline = (char *)memchr(start, '\n', mapped->length - input->position);
+    job->line = start;
+    job->length = newline != NULL ? (size_t)(newline - start) : mapped->length - input->position;
+    input->position += job->length + (newline != NULL);
+    /*the line is used where it is, the tokenizer only needs its length*/
+    return true;
+}
+
+static void doneBefore(BatchInput *input, BatchJob *job)
+/*the lines before the job have been written, so their part of the mapped file is not needed any more*/
+{
+    if (input->mapped != NULL) {
+        releaseMappedBefore(input->mapped, job->line - input->mapped->data);
+    }
+}
+
+bool processExpression(char *expression, size_t length, TokenList *tokenListPtr, OutputBuffer *out)
+{
+    Node *root = parseExpression(expression, length, tokenListPtr);
+    /*the tokenlist keeps its storage from the previous expression*/
+    if (root == NULL) {
+        outputFormat(out, "Invalid input\n");
+        return false;
+    }
+    calculateGradTo(root, out);
+    return true;
+}
+
+static void runJob(void *arg)
+/*a task of the pool, it only uses the arena and tokenlist of the thread it runs on*/
+{
+    BatchJob *job = (BatchJob *)arg;
+    job->output.length = 0;
+    job->valid = processExpression(job->line, job->length, threadTokenList(), &job->output);
+    releaseExpression();
+}
+
+static void finishJob(BatchJob *job, long *failures)
+{
+    fwrite(job->output.data, 1, job->output.length, stdout);
+    printf(BATCH_SEPARATOR "\n");
+    /*every input line ends its record with the separator, even if it failed*/
+    if (!job->valid) {
+        fprintf(stderr, "line %ld: invalid expression\n", job->lineNumber);
+        (*failures)++;
+        /*report the line and go on with the next one*/
+    }
+}
+
+static int fillWindow(BatchInput *input, BatchWindow *window, long *lineNumber)
+{
+    window->count = 0;
+    while (window->count < BATCH_WINDOW) {
+        BatchJob *job = &window->jobs[window->count];
+        if (!nextLine(input, job)) {
+            break;
+        }
+        job->lineNumber = ++(*lineNumber);
+        window->count++;
+    }
+    return window->count;
+}
+
+static long runBatchParallel(BatchInput *input, int workerCount)
+{
+    ThreadPool *pool = createThreadPool(workerCount);
+    setGradPool(pool);
+    /*a huge line can also spread its variables over the same workers*/
+    BatchWindow *windows = (BatchWindow *)calloc(2, sizeof(BatchWindow));
+    long lineNumber = 0, failures = 0;
+    int current = 0;
+
+    fillWindow(input, &windows[current], &lineNumber);
+    for (int i = 0; i < windows[current].count; i++) {
+        poolSubmit(pool, &windows[current].group, runJob, &windows[current].jobs[i]);
+    }
+    while (windows[current].count > 0) {
+        BatchWindow *next = &windows[1 - current];
+        fillWindow(input, next, &lineNumber);
+        for (int i = 0; i < next->count; i++) {
+            poolSubmit(pool, &next->group, runJob, &next->jobs[i]);
+            /*the next window is queued before the current one is written, so the workers never run dry*/
+        }
+        poolWait(pool, &windows[current].group);
+        for (int i = 0; i < windows[current].count; i++) {
+            finishJob(&windows[current].jobs[i], &failures);
+            /*the results are written in input order, whichever worker finished first*/
+        }
+        if (next->count > 0) {
+            doneBefore(input, &next->jobs[0]);
+        }
+        current = 1 - current;
+    }
+
+    poolWait(pool, &windows[current].group);
+    setGradPool(NULL);
+    destroyThreadPool(pool);
+    for (int w = 0; w < 2; w++) {
+        for (int i = 0; i < BATCH_WINDOW; i++) {
+            free(windows[w].jobs[i].text);
+            free(windows[w].jobs[i].output.data);
+        }
+    }
+    free(windows);
+    return failures;
+}
+
+static long runBatchInput(BatchInput *input, int workerCount)
+{
+    if (workerCount != 1) {
+        return runBatchParallel(input, workerCount);
+    }
+    BatchJob job;
+    memset(&job, 0, sizeof(BatchJob));
+    /*the line buffer, the output and the tokenlist are shared by every expression of the batch*/
+    long lineNumber = 0, failures = 0;
+
+    while (nextLine(input, &job)) {
+        job.lineNumber = ++lineNumber;
+        runJob(&job);
+        /*the arena is rewound after every line, so memory stays flat however many lines there are*/
+        finishJob(&job, &failures);
+        if (lineNumber % BATCH_WINDOW == 0) {
+            doneBefore(input, &job);
+        }
+    }
+    free(job.text);
+    free(job.output.data);
+    return failures;
+}
+
+long runBatch(FILE *input, int workerCount)
+{
+    BatchInput source = {input, NULL, 0};
+    return runBatchInput(&source, workerCount);
+}
+
+long runBatchMapped(MappedFile *file, int workerCount)
+{
+    BatchInput source = {NULL, file, 0};
+    return runBatchInput(&source, workerCount);
+}
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../header.h"
+
+/*rows per second of the value and the gradient of an expression over columns of random points,*/
+/*row by row with gradientProgram() against the blocks of evaluateColumns() in double and in float*/
+/*build from the code directory together with everything but main.c, for example; gcc and clang pick the vectors when it runs, cl needs /arch*/
+/*  gcc -O2 -o columnbench bench/columnbench.c arena.c batch.c columns.c dataset.c egraph.c functions.c mapfile.c parse.c poly.c pool.c program.c rope.c simplify.c tokenize.c -lm -lpthread*/
+/*  cl /O2 /arch:AVX512 /Fecolumnbench.exe bench\columnbench.c arena.c batch.c columns.c dataset.c egraph.c functions.c mapfile.c parse.c poly.c pool.c program.c rope.c simplify.c tokenize.c*/
+/*usage: columnbench [rows] [expression]*/
+
+static double seconds(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static double relativeError(double expected, double got)
+{
+    return fabs(expected - got) / (fabs(expected) > 1 ? fabs(expected) : 1);
+}
+
+int main(int argc, char *argv[])
+{
+    long rows = argc > 1 ? atol(argv[1]) : 1000000;
+    char *text = argc > 2 ? argv[2] : "w0*x0^3+w1*x0*x1^2-w2/(1+x1^2)+w3*x0^x1-w4*(x0-x1)^2+w5*(x0*x1+w6)^4";
+    Node *root = parseExpression(text, strlen(text), threadTokenList());
+    if (root == NULL) {
+        printf("the input is not an expression\n");
+        return 1;
+    }
+    Program *program = compileProgram(&root, 1);
+    int inputs = program->inputCount;
+    double **columns = (double **)malloc((inputs + 1) * sizeof(double *));
+    double **gradient = (double **)malloc((inputs + 1) * sizeof(double *));
+    float **floatColumns = (float **)malloc((inputs + 1) * sizeof(float *));
+    float **floatGradient = (float **)malloc((inputs + 1) * sizeof(float *));
+    srand(12345);
+    for (int s = 0; s < inputs; s++) {
+        columns[s] = (double *)malloc(rows * sizeof(double));
+        gradient[s] = (double *)malloc(rows * sizeof(double));
+        floatColumns[s] = (float *)malloc(rows * sizeof(float));
+        floatGradient[s] = (float *)malloc(rows * sizeof(float));
+        for (long r = 0; r < rows; r++) {
+            columns[s][r] = 1 + (double)rand() / RAND_MAX;
+            /*between 1 and 2, so the powers stay tame*/
+            floatColumns[s][r] = (float)columns[s][r];
+        }
+    }
+    double *values = (double *)malloc(rows * sizeof(double));
+    float *floatValues = (float *)malloc(rows * sizeof(float));
+    double *registers = (double *)malloc((program->count + 1) * sizeof(double));
+    double *adjoints = (double *)malloc((program->count + 1) * sizeof(double));
+    double *point = (double *)malloc((inputs + 1) * sizeof(double));
+    double *pointGradient = (double *)malloc((inputs + 1) * sizeof(double));
+    printf("%d instructions, %d inputs, %ld rows, %s\n", program->count, inputs, rows, columnSimdName());
+
+    clock_t start = clock();
+    double scalarSum = 0;
+    for (long r = 0; r < rows; r++) {
+        for (int s = 0; s < inputs; s++) {
+            point[s] = columns[s][r];
+        }
+        scalarSum += gradientProgram(program, 0, point, registers, adjoints, pointGradient);
+    }
+    double scalarSeconds = seconds(start);
+    printf("row by row, value + gradient  %8.2f M rows/s\n", rows / scalarSeconds / 1e6);
+
+    start = clock();
+    evaluateColumns(program, 0, (const double *const *)columns, rows, values, NULL);
+    printf("double, value                 %8.2f M rows/s\n", rows / seconds(start) / 1e6);
+    start = clock();
+    evaluateColumns(program, 0, (const double *const *)columns, rows, values, gradient);
+    printf("double, value + gradient      %8.2f M rows/s\n", rows / seconds(start) / 1e6);
+    start = clock();
+    evaluateColumnsFloat(program, 0, (const float *const *)floatColumns, rows, floatValues, NULL);
+    printf("float, value                  %8.2f M rows/s\n", rows / seconds(start) / 1e6);
+    start = clock();
+    evaluateColumnsFloat(program, 0, (const float *const *)floatColumns, rows, floatValues, floatGradient);
+    printf("float, value + gradient       %8.2f M rows/s\n", rows / seconds(start) / 1e6);
+
+    double worst = 0, worstFloat = 0, columnSum = 0;
+    for (long r = 0; r < rows; r += 97) {
+        for (int s = 0; s < inputs; s++) {
+            point[s] = columns[s][r];
+        }
+        double value = gradientProgram(program, 0, point, registers, adjoints, pointGradient);
+        worst = fmax(worst, relativeError(value, values[r]));
+        worstFloat = fmax(worstFloat, relativeError(value, floatValues[r]));
+        for (int s = 0; s < inputs; s++) {
+            worst = fmax(worst, relativeError(pointGradient[s], gradient[s][r]));
+            worstFloat = fmax(worstFloat, relativeError(pointGradient[s], floatGradient[s][r]));
+        }
+    }
+    for (long r = 0; r < rows; r++) {
+        columnSum += values[r];
+    }
+    printf("largest relative difference to row by row: double %.3g, float %.3g\n", worst, worstFloat);
+    printf("sum of the values: row by row %.17g, columns %.17g\n", scalarSum, columnSum);
+
+    for (int s = 0; s < inputs; s++) {
+        free(columns[s]);
+        free(gradient[s]);
+        free(floatColumns[s]);
+        free(floatGradient[s]);
+    }
+    free(columns);
+    free(gradient);
+    free(floatColumns);
+    free(floatGradient);
+    free(values);
+    free(floatValues);
+    free(registers);
+    free(adjoints);
+    free(point);
+    free(pointGradient);
+    freeProgram(program);
+    releaseExpression();
+    return worst < 1e-9 && worstFloat < 1e-3 ? 0 : 1;
+}
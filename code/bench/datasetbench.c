@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "../header.h"
+
+/*rows per second of evaluateDataset() over a CSV and a binary file of random points with 1, 2 and 4 threads,*/
+/*with a check that every run gives bit for bit the same sums, whatever the threads and the format*/
+/*build from the code directory together with everything but main.c, for example*/
+/*  gcc -O2 -o datasetbench bench/datasetbench.c arena.c batch.c columns.c dataset.c egraph.c functions.c mapfile.c parse.c poly.c pool.c program.c rope.c simplify.c tokenize.c -lm -lpthread*/
+/*  cl /O2 /arch:AVX2 /Fedatasetbench.exe bench\datasetbench.c arena.c batch.c columns.c dataset.c egraph.c functions.c mapfile.c parse.c poly.c pool.c program.c rope.c simplify.c tokenize.c*/
+/*usage: datasetbench [rows] [directory], the two files are written into the directory and removed at the end*/
+
+#define COLUMNS 9
+/*the inputs of the expression and one column it doesn't use*/
+
+static double wallSeconds(void)
+{
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void writeFiles(const char *csvPath, const char *binaryPath, long rows)
+{
+    static const char *header = "w0,w1,w2,unused,w3,w4,x0,x1,x2\n";
+    FILE *csv = fopen(csvPath, "w");
+    FILE *binary = fopen(binaryPath, "wb");
+    fputs(header, csv);
+    fwrite("GRADCOLS", 1, 8, binary);
+    fputs(header, binary);
+    srand(12345);
+    double row[COLUMNS];
+    for (long r = 0; r < rows; r++) {
+        for (int c = 0; c < COLUMNS; c++) {
+            row[c] = 1 + (double)rand() / RAND_MAX;
+            fprintf(csv, c + 1 < COLUMNS ? "%.17g," : "%.17g\n", row[c]);
+            /*17 digits read back to the same double, so both files hold the same points*/
+        }
+        fwrite(row, sizeof(double), COLUMNS, binary);
+    }
+    fclose(csv);
+    fclose(binary);
+}
+
+static bool run(const char *path, const char *name, Program *program, int threads, long rows, DatasetTotals *first)
+{
+    FILE *file = fopen(path, "rb");
+    DatasetTotals totals;
+    double start = wallSeconds();
+    evaluateDataset(file, program, threads, &totals);
+    double seconds = wallSeconds() - start;
+    fclose(file);
+    printf("%-6s %d threads %8.2f M rows/s\n", name, threads, rows / seconds / 1e6);
+    bool same = true;
+    if (first->gradient == NULL) {
+        *first = totals;
+        return true;
+    }
+    same = totals.rows == first->rows && totals.value == first->value;
+    for (int s = 0; s < totals.inputCount; s++) {
+        same = same && totals.gradient[s] == first->gradient[s];
+    }
+    free(totals.gradient);
+    return same;
+}
+
+int main(int argc, char *argv[])
+{
+    long rows = argc > 1 ? atol(argv[1]) : 2000000;
+    const char *directory = argc > 2 ? argv[2] : ".";
+    char csvPath[4096], binaryPath[4096];
+    snprintf(csvPath, sizeof(csvPath), "%s/datasetbench.csv", directory);
+    snprintf(binaryPath, sizeof(binaryPath), "%s/datasetbench.bin", directory);
+    char *text = "w0*x0^3+w1*x0*x1^2-w2/(1+x1^2)+w3*(x0-x2)^2+w4*(x0*x1+x2)^4";
+    Node *root = parseExpression(text, strlen(text), threadTokenList());
+    Program *program = compileProgram(&root, 1);
+    releaseExpression();
+    writeFiles(csvPath, binaryPath, rows);
+
+    DatasetTotals first;
+    memset(&first, 0, sizeof(DatasetTotals));
+    bool same = true;
+    int threads[] = {1, 2, 4};
+    for (int i = 0; i < 3; i++) {
+        same = run(binaryPath, "binary", program, threads[i], rows, &first) && same;
+    }
+    for (int i = 0; i < 3; i++) {
+        same = run(csvPath, "csv", program, threads[i], rows, &first) && same;
+    }
+    printf("%ld rows, value %.17g, every run %s\n", first.rows, first.value, same ? "the same" : "NOT the same");
+    free(first.gradient);
+    freeProgram(program);
+    remove(csvPath);
+    remove(binaryPath);
+    return same ? 0 : 1;
+}
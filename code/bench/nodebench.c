@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "../header.h"
+
+/*time of a walk over the expression that chases the Left and Right pointers of the nodes,*/
+/*against the same walk as a sweep over the packed nodes of the store*/
+/*build from the code directory together with everything but main.c, for example*/
+/*  gcc -O2 -o nodebench bench/nodebench.c arena.c batch.c columns.c dataset.c egraph.c functions.c mapfile.c parse.c poly.c pool.c program.c rope.c simplify.c tokenize.c -lm -lpthread*/
+/*  cl /O2 /Fenodebench.exe bench\nodebench.c arena.c batch.c columns.c dataset.c egraph.c functions.c mapfile.c parse.c poly.c pool.c program.c rope.c simplify.c tokenize.c*/
+/*usage: nodebench [terms] [rounds], the cache misses of the two walks can be compared with perf stat -e cache-misses*/
+
+static char *makeInput(int terms)
+/*a sum of products of random variables and numbers, in groups so that the tree is not too deep*/
+{
+    size_t capacity = (size_t)terms * 32 + 16, used = 0;
+    char *text = (char *)malloc(capacity);
+    srand(12345);
+    text[used++] = '(';
+    for (int i = 0; i < terms; i++) {
+        if (i > 0) {
+            used += sprintf(text + used, i % 64 == 0 ? ")+(" : "+");
+        }
+        used += sprintf(text + used, "v%d*v%d*%d", rand() % 5000, rand() % 5000, rand() % 100000);
+    }
+    text[used++] = ')';
+    text[used] = '\0';
+    return text;
+}
+
+static long pointerWalk(Node *root, unsigned char *seen, Node **stack)
+/*depth-first walk through the pointers, every shared node is visited once*/
+{
+    long variables = 0;
+    int top = 0;
+    stack[top++] = root;
+    while (top > 0) {
+        Node *node = stack[--top];
+        if (seen[node->id]) {
+            continue;
+        }
+        seen[node->id] = 1;
+        if (node->type == TOKEN_IS_VAR) {
+            variables++;
+        }
+        else if (node->type == TOKEN_IS_OPERATOR) {
+            stack[top++] = node->Right;
+            stack[top++] = node->Left;
+        }
+    }
+    return variables;
+}
+
+static long packedWalk(NodeStore *store, Node *root, unsigned char *seen)
+/*the same walk as a sweep down and up the packed array*/
+{
+    long variables = 0;
+    markReachable(store, root->id, seen);
+    for (int id = 0; id <= root->id; id++) {
+        if (seen[id] && PACKED_TYPE(store->packed[id].tag) == TOKEN_IS_VAR) {
+            variables++;
+        }
+    }
+    return variables;
+}
+
+static double seconds(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char *argv[])
+{
+    int terms = argc > 1 ? atoi(argv[1]) : 1000000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 5;
+    char *text = makeInput(terms);
+    Node *root = parseExpression(text, strlen(text), threadTokenList());
+    if (root == NULL) {
+        printf("the input is not an expression\n");
+        return 1;
+    }
+    NodeStore *store = currentNodeStore();
+    int count = nodeStoreSize();
+    unsigned char *seen = (unsigned char *)malloc(count);
+    Node **stack = (Node **)malloc(2 * (size_t)count * sizeof(Node *));
+    double pointerBest = -1, packedBest = -1;
+    long pointerVariables = 0, packedVariables = 0;
+
+    for (int i = 0; i < rounds; i++) {
+        memset(seen, 0, count);
+        clock_t start = clock();
+        pointerVariables = pointerWalk(root, seen, stack);
+        double pointerSeconds = seconds(start);
+        memset(seen, 0, count);
+        start = clock();
+        packedVariables = packedWalk(store, root, seen);
+        double packedSeconds = seconds(start);
+        if (pointerBest < 0 || pointerSeconds < pointerBest) {
+            pointerBest = pointerSeconds;
+        }
+        if (packedBest < 0 || packedSeconds < packedBest) {
+            packedBest = packedSeconds;
+        }
+    }
+    printf("%d nodes, %ld variable leaves\n", count, packedVariables);
+    printf("pointers %8.2f ns per node, %zu bytes per node\n", pointerBest * 1e9 / count, sizeof(Node));
+    printf("packed   %8.2f ns per node, %zu bytes per node\n", packedBest * 1e9 / count, sizeof(PackedNode));
+    if (pointerVariables != packedVariables) {
+        printf("the walks disagree: %ld and %ld\n", pointerVariables, packedVariables);
+        return 1;
+    }
+    free(stack);
+    free(seen);
+    releaseExpression();
+    free(text);
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../header.h"
+
+/*the gradients of expressions that once went wrong, against the text they have to give*/
+/*build from the code directory together with everything but main.c, for example*/
+/*  gcc -O2 -o regress bench/regress.c arena.c batch.c columns.c dataset.c egraph.c functions.c mapfile.c parse.c poly.c pool.c program.c rope.c simplify.c tokenize.c -lm -lpthread*/
+/*  cl /O2 /Feregress.exe bench\regress.c arena.c batch.c columns.c dataset.c egraph.c functions.c mapfile.c parse.c poly.c pool.c program.c rope.c simplify.c tokenize.c*/
+/*usage: regress, the exit code is the number of cases that failed*/
+
+typedef struct RegressCase {
+    char *input;
+    char *expected;
+} RegressCase;
+
+static RegressCase cases[] = {
+    {"x*2147483647", "x: 2147483647\n"},
+    {"x*2147483648", "Invalid input\n"},
+    {"x^4294967295", "Invalid input\n"},
+    /*literals that don't fit an int are rejected instead of wrapping around*/
+    {"x/(0-2147483647-1)", "x: (1 / ((-2147483647) - 1))\n"},
+    {"x/(4-2147483647-1)", "x: ((-1) / 2147483644)\n"},
+    /*a fraction with INT_MIN in it can not be reduced, it has to be kept as it is*/
+    {"x^(0-1)", "x: (-(1 / (x ^ 2)))\n"},
+    {"(x+y)^(0-1)", "x: (-(1 / ((x + y) ^ 2)))\ny: (-(1 / ((x + y) ^ 2)))\n"},
+    /*a power of -1 is no polynomial, it must not become the constant 1*/
+    {"x^(0-2147483647-1)", "x: (((x ^ ((-2147483647) - 1)) * ((-2147483647) - 1)) / x)\n"},
+};
+
+static char *optimizedInputs[] = {
+    "13 / z1-(x^(13 ^ y ^ (_a)))",
+    "((_a^ y / 13^13) ^ (2)-w +z1 ^y ^ w-_a/ _a)",
+    "2 - _a^((13*y)*x - (z1 / y) *13 + x* 13+ y /2)",
+    "((w) *z1 +2 - z1- _a* ((y)))^_a+_a",
+    "(13/y/ (_a ^ (13) * 13-2^ _a+ z1)) /w -(x)",
+};
+/*the slowest expressions of the optimizer, --optimize has to give the same output with any number of threads*/
+/*and however much the threads slow each other down*/
+
+#define REGRESS_THREADS 4
+#define REGRESS_COPIES 4
+/*every expression is optimized this many times at once on the pool*/
+#define OPTIMIZED_COUNT ((int)(sizeof(optimizedInputs) / sizeof(optimizedInputs[0])))
+
+typedef struct OptimizedJob {
+    char *input;
+    OutputBuffer output;
+} OptimizedJob;
+
+static void runOptimized(void *arg)
+{
+    OptimizedJob *job = (OptimizedJob *)arg;
+    processExpression(job->input, strlen(job->input), threadTokenList(), &job->output);
+    releaseExpression();
+}
+
+static int compareThreads(void)
+/*every expression optimized on this thread, against copies of all of them at once on a pool, return the number that differ*/
+{
+    OptimizeBudget budget = {OPTIMIZE_NODE_BUDGET, OPTIMIZE_ROUND_BUDGET, 0, 'e'};
+    setGradOptimizer(&budget);
+    OptimizedJob alone[OPTIMIZED_COUNT], pooled[OPTIMIZED_COUNT * REGRESS_COPIES];
+    for (int i = 0; i < OPTIMIZED_COUNT; i++) {
+        alone[i] = (OptimizedJob){optimizedInputs[i], {NULL, 0, 0}};
+        runOptimized(&alone[i]);
+    }
+    ThreadPool *pool = createThreadPool(REGRESS_THREADS);
+    TaskGroup group = {0};
+    for (int i = 0; i < OPTIMIZED_COUNT * REGRESS_COPIES; i++) {
+        pooled[i] = (OptimizedJob){optimizedInputs[i % OPTIMIZED_COUNT], {NULL, 0, 0}};
+        poolSubmit(pool, &group, runOptimized, &pooled[i]);
+    }
+    poolWait(pool, &group);
+    destroyThreadPool(pool);
+    setGradOptimizer(NULL);
+    int failures = 0;
+    for (int i = 0; i < OPTIMIZED_COUNT * REGRESS_COPIES; i++) {
+        OptimizedJob *expected = &alone[i % OPTIMIZED_COUNT];
+        if (expected->output.length != pooled[i].output.length
+            || memcmp(expected->output.data, pooled[i].output.data, expected->output.length) != 0) {
+            printf("%s --optimize\n  1 thread  %.*s  %d threads %.*s", pooled[i].input, (int)expected->output.length,
+                   expected->output.data, REGRESS_THREADS, (int)pooled[i].output.length, pooled[i].output.data);
+            failures++;
+        }
+        free(pooled[i].output.data);
+    }
+    for (int i = 0; i < OPTIMIZED_COUNT; i++) {
+        free(alone[i].output.data);
+    }
+    return failures;
+}
+
+int main(void)
+{
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        OutputBuffer out = {NULL, 0, 0};
+        processExpression(cases[i].input, strlen(cases[i].input), threadTokenList(), &out);
+        /*an invalid input gives its message in out as well*/
+        bool same = out.length == strlen(cases[i].expected) && memcmp(out.data, cases[i].expected, out.length) == 0;
+        if (!same) {
+            printf("%s\n  expected %s  got      %.*s", cases[i].input, cases[i].expected, (int)out.length, out.data);
+            failures++;
+        }
+        free(out.data);
+        releaseExpression();
+    }
+    failures += compareThreads();
+    printf("%d of %d cases failed\n", failures, (int)(sizeof(cases) / sizeof(cases[0])) + OPTIMIZED_COUNT * REGRESS_COPIES);
+    return failures;
+}
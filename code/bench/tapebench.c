@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../header.h"
+
+/*time of the value and the gradient of an expression at a point with the compiled tape, per instruction,*/
+/*against evaluating the simplified symbolic derivatives compiled the same way, with a check that both agree*/
+/*build from the code directory together with everything but main.c, for example*/
+/*  gcc -O2 -o tapebench bench/tapebench.c arena.c batch.c columns.c dataset.c egraph.c functions.c mapfile.c parse.c poly.c pool.c program.c rope.c simplify.c tokenize.c -lm -lpthread*/
+/*  cl /O2 /Fetapebench.exe bench\tapebench.c arena.c batch.c columns.c dataset.c egraph.c functions.c mapfile.c parse.c poly.c pool.c program.c rope.c simplify.c tokenize.c*/
+/*usage: tapebench [terms] [variables] [rounds]*/
+
+static char *makeInput(int terms, int variables)
+/*a sum of quotients, products and small powers of random variables, in groups so that the tree is not too deep*/
+{
+    size_t capacity = (size_t)terms * 64 + 16, used = 0;
+    char *text = (char *)malloc(capacity);
+    srand(12345);
+    text[used++] = '(';
+    for (int i = 0; i < terms; i++) {
+        if (i > 0) {
+            used += sprintf(text + used, i % 64 == 0 ? ")+(" : i % 3 == 0 ? "-" : "+");
+        }
+        int a = rand() % variables, b = rand() % variables, c = rand() % variables;
+        switch (i % 3) {
+            case 0:
+                used += sprintf(text + used, "v%d*v%d/(v%d+%d)", a, b, c, rand() % 9 + 1);
+                break;
+            case 1:
+                used += sprintf(text + used, "%d*v%d^%d*v%d", rand() % 9 + 1, a, rand() % 4 + 2, b);
+                break;
+            default:
+                used += sprintf(text + used, "v%d^v%d", a, b);
+                break;
+        }
+    }
+    text[used++] = ')';
+    text[used] = '\0';
+    return text;
+}
+
+static double seconds(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char *argv[])
+{
+    int terms = argc > 1 ? atoi(argv[1]) : 100000;
+    int variables = argc > 2 ? atoi(argv[2]) : 1000;
+    int rounds = argc > 3 ? atoi(argv[3]) : 20;
+    char *text = makeInput(terms, variables);
+    Node *root = parseExpression(text, strlen(text), threadTokenList());
+    if (root == NULL) {
+        printf("the input is not an expression\n");
+        return 1;
+    }
+    Program *program = compileProgram(&root, 1);
+    int inputCount = program->inputCount;
+    double *inputs = (double *)malloc((inputCount + 1) * sizeof(double));
+    for (int i = 0; i < inputCount; i++) {
+        inputs[i] = 1 + (double)rand() / RAND_MAX;
+        /*between 1 and 2, so the powers and the logarithms stay tame*/
+    }
+    double *registers = (double *)malloc((program->count + 1) * sizeof(double));
+    double *adjoints = (double *)malloc((program->count + 1) * sizeof(double));
+    double *gradient = (double *)malloc((inputCount + 1) * sizeof(double));
+
+    GradTape tape = {NULL, 0, 0, NULL, 0};
+    recordTape(&root, 1, &tape, NULL);
+    VarList list = {NULL, 0, NULL};
+    collectVariables(&root, 1, &list);
+    qsort(list.symbols, list.count, sizeof(int), compareSymbols);
+    Node **partials = (Node **)malloc((list.count + 1) * sizeof(Node *));
+    backward(&tape, list.symbols, list.count, partials);
+    simplifyAll(partials, list.count);
+    Program *symbolic = compileProgram(partials, list.count);
+    double *symbolicRegisters = (double *)malloc((symbolic->count + 1) * sizeof(double));
+    double *symbolicInputs = (double *)malloc((symbolic->inputCount + 1) * sizeof(double));
+    for (int i = 0; i < symbolic->inputCount; i++) {
+        symbolicInputs[i] = inputs[programInput(program, symbolic->names[i], strlen(symbolic->names[i]))];
+        /*a derivative can lose a variable, so the slots of the two programs are matched by name*/
+    }
+
+    double valueBest = -1, gradientBest = -1, symbolicBest = -1, value = 0;
+    for (int r = 0; r < rounds; r++) {
+        clock_t start = clock();
+        evaluateProgram(program, inputs, registers);
+        double valueSeconds = seconds(start);
+        start = clock();
+        value = gradientProgram(program, 0, inputs, registers, adjoints, gradient);
+        double gradientSeconds = seconds(start);
+        start = clock();
+        evaluateProgram(symbolic, symbolicInputs, symbolicRegisters);
+        double symbolicSeconds = seconds(start);
+        if (valueBest < 0 || valueSeconds < valueBest) {
+            valueBest = valueSeconds;
+        }
+        if (gradientBest < 0 || gradientSeconds < gradientBest) {
+            gradientBest = gradientSeconds;
+        }
+        if (symbolicBest < 0 || symbolicSeconds < symbolicBest) {
+            symbolicBest = symbolicSeconds;
+        }
+    }
+
+    double worst = 0;
+    for (int i = 0; i < list.count; i++) {
+        double expected = symbolicRegisters[symbolic->outputs[i]], got = gradient[i];
+        double error = fabs(expected - got) / (fabs(expected) > 1 ? fabs(expected) : 1);
+        worst = error > worst ? error : worst;
+    }
+    printf("%d instructions, %d inputs, value %.17g\n", program->count, inputCount, value);
+    printf("value             %8.2f ns per instruction\n", valueBest * 1e9 / program->count);
+    printf("value + gradient  %8.2f ns per instruction, %.3f ms\n", gradientBest * 1e9 / program->count, gradientBest * 1e3);
+    printf("symbolic gradient %8d instructions, %.3f ms\n", symbolic->count, symbolicBest * 1e3);
+    printf("largest relative difference %.3g\n", worst);
+    freeProgram(symbolic);
+    freeProgram(program);
+    freeTape(&tape);
+    free(symbolicInputs);
+    free(symbolicRegisters);
+    free(partials);
+    free(gradient);
+    free(adjoints);
+    free(registers);
+    free(inputs);
+    releaseExpression();
+    free(text);
+    return worst < 1e-9 ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "../header.h"
+
+/*throughput of the tokenizers in GB/s, and a check that the SIMD one gives exactly the tokens of the scalar one*/
+/*build from the code directory together with everything but main.c, for example*/
+/*  gcc -O2 -o tokenbench bench/tokenbench.c arena.c batch.c columns.c dataset.c egraph.c functions.c mapfile.c parse.c poly.c pool.c program.c rope.c simplify.c tokenize.c -lm -lpthread*/
+/*  cl /O2 /arch:AVX2 /Fetokenbench.exe bench\tokenbench.c arena.c batch.c columns.c dataset.c egraph.c functions.c mapfile.c parse.c poly.c pool.c program.c rope.c simplify.c tokenize.c*/
+/*usage: tokenbench [megabytes] [rounds]*/
+
+static char *makeInput(size_t length)
+/*random text that looks like expressions, with long names and numbers, stray characters and tokens across blocks*/
+{
+    static char *pieces[] = {"x", "y1", "_tmp", "alpha_2", "3", "42", "1234567", "2147483647", "98765432109",
+                             "007", "2x", "+", "-", "*", "/", "^", "(", ")", " ", "  ", "\t", "#", "\xe9"};
+    int pieceCount = sizeof(pieces) / sizeof(pieces[0]);
+    char *text = (char *)malloc(length + 1);
+    size_t used = 0;
+    srand(12345);
+    while (used < length) {
+        char *piece = pieces[rand() % pieceCount];
+        size_t pieceLength = strlen(piece);
+        if (used + pieceLength > length) {
+            pieceLength = length - used;
+        }
+        memcpy(text + used, piece, pieceLength);
+        used += pieceLength;
+    }
+    text[length] = '\0';
+    return text;
+}
+
+static double bestSeconds(void (*run)(char *, size_t, TokenList *), char *text, size_t length, TokenList *tokens, int rounds)
+{
+    double best = -1;
+    for (int i = 0; i < rounds; i++) {
+        clock_t start = clock();
+        run(text, length, tokens);
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+        if (best < 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best > 0 ? best : 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t megabytes = argc > 1 ? (size_t)atol(argv[1]) : 64;
+    int rounds = argc > 2 ? atoi(argv[2]) : 5;
+    size_t length = megabytes * 1024 * 1024;
+    char *text = makeInput(length);
+    TokenList scalar, simd;
+    memset(&scalar, 0, sizeof(scalar));
+    memset(&simd, 0, sizeof(simd));
+
+    double scalarSeconds = bestSeconds(tokenizeScalar, text, length, &scalar, rounds);
+    double simdSeconds = bestSeconds(tokenizeRange, text, length, &simd, rounds);
+    printf("%zu MB, %d tokens\n", megabytes, scalar.count);
+    printf("scalar  %8.3f GB/s\n", length / scalarSeconds / 1e9);
+    printf("%-7s %8.3f GB/s\n", tokenizerName(), length / simdSeconds / 1e9);
+
+    if (scalar.count != simd.count) {
+        printf("token counts differ: %d and %d\n", scalar.count, simd.count);
+        return 1;
+    }
+    for (int i = 0; i < scalar.count; i++) {
+        Token *a = &scalar.tokens[i], *b = &simd.tokens[i];
+        if (a->type != b->type || a->operator != b->operator || a->length != b->length || a->offset != b->offset || a->value != b->value) {
+            printf("token %d differs at offset %zu\n", i, a->offset);
+            return 1;
+        }
+    }
+    printf("the tokens are the same\n");
+    freeTokenList(&scalar);
+    freeTokenList(&simd);
+    free(text);
+    return 0;
+}
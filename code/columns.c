@@ -0,0 +1,495 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "header.h"
+
+/*necessary header files included*/
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define COLUMN_DISPATCH
+/*GCC and Clang build the AVX-512, AVX2 and scalar operations and pick the widest the processor has when the program runs*/
+#elif defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+/*other compilers only have the operations the build switched on, with /arch:AVX2 or /arch:AVX512*/
+#endif
+/*the block of rows is a multiple of COLUMN_MIN_ROWS, so a vector never runs over the end of a register*/
+
+#define COLUMN_MAX_EXPONENT 64
+/*a power with a constant exponent up to this is multiplied out in the vectors instead of calling pow() for every row*/
+
+typedef struct RowOps {
+    size_t size;
+    /*bytes of one value, 8 for double and 4 for float*/
+    void (*fill)(void *out, double x, int n);
+    void (*load)(void *out, const void *column, long first, int count, int n);
+    /*copy count rows of the column from first on, the rest of the block is padded with ones*/
+    void (*store)(void *column, long first, const void *rows, int count);
+    void (*add)(void *out, const void *a, const void *b, int n);
+    void (*subtract)(void *out, const void *a, const void *b, int n);
+    void (*multiply)(void *out, const void *a, const void *b, int n);
+    void (*divide)(void *out, const void *a, const void *b, int n);
+    void (*negate)(void *out, const void *a, int n);
+    void (*power)(void *out, const void *a, const void *b, int n);
+    void (*powerInt)(void *out, const void *a, int exponent, int n);
+    void (*logarithm)(void *out, const void *a, int n);
+    void (*accumulate)(void *out, const void *a, int n);
+    /*out += a*/
+    void (*deduct)(void *out, const void *a, int n);
+    /*out -= a*/
+    void (*accumulateProduct)(void *out, const void *a, const void *b, int n);
+    /*out += a * b*/
+    void (*accumulateQuotient)(void *out, const void *a, const void *b, int n);
+    /*out += a / b*/
+    void (*deductScaledQuotient)(void *out, const void *a, const void *b, const void *c, int n);
+    /*out -= a * b / c*/
+    void (*accumulatePowerLeft)(void *out, const void *adjoint, const void *a, const void *b, int n);
+    /*out += adjoint * b * a ^ (b - 1)*/
+    void (*accumulatePowerIntLeft)(void *out, const void *adjoint, const void *a, int exponent, int n);
+    void (*accumulatePowerRight)(void *out, const void *adjoint, const void *value, const void *a, int n);
+    /*out += adjoint * a ^ b * ln(a)*/
+} RowOps;
+/*the operations on blocks of n rows, one set for double and one for float per instruction set, so the evaluator is written once*/
+
+#define ROW_OPS(Isa, Real, real)                                                                                \
+static Isa##Target void fill##Real##Isa(void *out, double x, int n)                                             \
+{                                                                                                               \
+    Real##Vector##Isa v = splat##Real##Isa((real)x);                                                            \
+    for (int k = 0; k < n; k += Real##Lanes##Isa) {                                                             \
+        store##Real##Isa((real *)out + k, v);                                                                   \
+    }                                                                                                           \
+}                                                                                                               \
+static Isa##Target void load##Real##Rows##Isa(void *out, const void *column, long first, int count, int n)      \
+{                                                                                                               \
+    memcpy(out, (const real *)column + first, count * sizeof(real));                                            \
+    for (int k = count; k < n; k++) {                                                                           \
+        ((real *)out)[k] = 1;                                                                                   \
+    }                                                                                                           \
+}                                                                                                               \
+static Isa##Target void store##Real##Rows##Isa(void *column, long first, const void *rows, int count)           \
+{                                                                                                               \
+    memcpy((real *)column + first, rows, count * sizeof(real));                                                 \
+}                                                                                                               \
+static Isa##Target void add##Real##Rows##Isa(void *out, const void *a, const void *b, int n)                    \
+{                                                                                                               \
+    for (int k = 0; k < n; k += Real##Lanes##Isa) {                                                             \
+        store##Real##Isa((real *)out + k, add##Real##Isa(load##Real##Isa((const real *)a + k), load##Real##Isa((const real *)b + k))); \
+    }                                                                                                           \
+}                                                                                                               \
+static Isa##Target void subtract##Real##Rows##Isa(void *out, const void *a, const void *b, int n)               \
+{                                                                                                               \
+    for (int k = 0; k < n; k += Real##Lanes##Isa) {                                                             \
+        store##Real##Isa((real *)out + k, sub##Real##Isa(load##Real##Isa((const real *)a + k), load##Real##Isa((const real *)b + k))); \
+    }                                                                                                           \
+}                                                                                                               \
+static Isa##Target void multiply##Real##Rows##Isa(void *out, const void *a, const void *b, int n)               \
+{                                                                                                               \
+    for (int k = 0; k < n; k += Real##Lanes##Isa) {                                                             \
+        store##Real##Isa((real *)out + k, mul##Real##Isa(load##Real##Isa((const real *)a + k), load##Real##Isa((const real *)b + k))); \
+    }                                                                                                           \
+}                                                                                                               \
+static Isa##Target void divide##Real##Rows##Isa(void *out, const void *a, const void *b, int n)                 \
+{                                                                                                               \
+    for (int k = 0; k < n; k += Real##Lanes##Isa) {                                                             \
+        store##Real##Isa((real *)out + k, div##Real##Isa(load##Real##Isa((const real *)a + k), load##Real##Isa((const real *)b + k))); \
+    }                                                                                                           \
+}                                                                                                               \
+static Isa##Target void negate##Real##Rows##Isa(void *out, const void *a, int n)                                \
+{                                                                                                               \
+    Real##Vector##Isa zero = splat##Real##Isa(0);                                                               \
+    for (int k = 0; k < n; k += Real##Lanes##Isa) {                                                             \
+        store##Real##Isa((real *)out + k, sub##Real##Isa(zero, load##Real##Isa((const real *)a + k)));          \
+    }                                                                                                           \
+}                                                                                                               \
+static Isa##Target void power##Real##Rows##Isa(void *out, const void *a, const void *b, int n)                  \
+{                                                                                                               \
+    for (int k = 0; k < n; k++) {                                                                               \
+        ((real *)out)[k] = (real)pow(((const real *)a)[k], ((const real *)b)[k]);                               \
+    }                                                                                                           \
+}                                                                                                               \
+static Isa##Target Real##Vector##Isa powerVector##Real##Isa(Real##Vector##Isa base, int exponent)               \
+{                                                                                                               \
+    Real##Vector##Isa result = splat##Real##Isa(1);                                                             \
+    while (exponent > 0) {                                                                                      \
+        if (exponent & 1) {                                                                                     \
+            result = mul##Real##Isa(result, base);                                                              \
+        }                                                                                                       \
+        exponent >>= 1;                                                                                         \
+        if (exponent > 0) {                                                                                     \
+            base = mul##Real##Isa(base, base);                                                                  \
+        }                                                                                                       \
+    }                                                                                                           \
+    return result;                                                                                              \
+}                                                                                                               \
+static Isa##Target void powerInt##Real##Rows##Isa(void *out, const void *a, int exponent, int n)                \
+{                                                                                                               \
+    for (int k = 0; k < n; k += Real##Lanes##Isa) {                                                             \
+        store##Real##Isa((real *)out + k, powerVector##Real##Isa(load##Real##Isa((const real *)a + k), exponent)); \
+    }                                                                                                           \
+}                                                                                                               \
+static Isa##Target void logarithm##Real##Rows##Isa(void *out, const void *a, int n)                             \
+{                                                                                                               \
+    for (int k = 0; k < n; k++) {                                                                               \
+        ((real *)out)[k] = (real)log(((const real *)a)[k]);                                                     \
+    }                                                                                                           \
+}                                                                                                               \
+static Isa##Target void accumulate##Real##Rows##Isa(void *out, const void *a, int n)                            \
+{                                                                                                               \
+    add##Real##Rows##Isa(out, out, a, n);                                                                       \
+}                                                                                                               \
+static Isa##Target void deduct##Real##Rows##Isa(void *out, const void *a, int n)                                \
+{                                                                                                               \
+    subtract##Real##Rows##Isa(out, out, a, n);                                                                  \
+}                                                                                                               \
+static Isa##Target void accumulateProduct##Real##Rows##Isa(void *out, const void *a, const void *b, int n)      \
+{                                                                                                               \
+    for (int k = 0; k < n; k += Real##Lanes##Isa) {                                                             \
+        Real##Vector##Isa product = mul##Real##Isa(load##Real##Isa((const real *)a + k), load##Real##Isa((const real *)b + k)); \
+        store##Real##Isa((real *)out + k, add##Real##Isa(load##Real##Isa((real *)out + k), product));           \
+    }                                                                                                           \
+}                                                                                                               \
+static Isa##Target void accumulateQuotient##Real##Rows##Isa(void *out, const void *a, const void *b, int n)     \
+{                                                                                                               \
+    for (int k = 0; k < n; k += Real##Lanes##Isa) {                                                             \
+        Real##Vector##Isa quotient = div##Real##Isa(load##Real##Isa((const real *)a + k), load##Real##Isa((const real *)b + k)); \
+        store##Real##Isa((real *)out + k, add##Real##Isa(load##Real##Isa((real *)out + k), quotient));          \
+    }                                                                                                           \
+}                                                                                                               \
+static Isa##Target void deductScaledQuotient##Real##Rows##Isa(void *out, const void *a, const void *b, const void *c, int n) \
+{                                                                                                               \
+    for (int k = 0; k < n; k += Real##Lanes##Isa) {                                                             \
+        Real##Vector##Isa product = mul##Real##Isa(load##Real##Isa((const real *)a + k), load##Real##Isa((const real *)b + k)); \
+        Real##Vector##Isa quotient = div##Real##Isa(product, load##Real##Isa((const real *)c + k));             \
+        store##Real##Isa((real *)out + k, sub##Real##Isa(load##Real##Isa((real *)out + k), quotient));          \
+    }                                                                                                           \
+}                                                                                                               \
+static Isa##Target void accumulatePowerLeft##Real##Rows##Isa(void *out, const void *adjoint, const void *a, const void *b, int n) \
+{                                                                                                               \
+    for (int k = 0; k < n; k++) {                                                                               \
+        real exponent = ((const real *)b)[k];                                                                   \
+        ((real *)out)[k] += ((const real *)adjoint)[k] * exponent * (real)pow(((const real *)a)[k], exponent - 1); \
+    }                                                                                                           \
+}                                                                                                               \
+static Isa##Target void accumulatePowerIntLeft##Real##Rows##Isa(void *out, const void *adjoint, const void *a, int exponent, int n) \
+{                                                                                                               \
+    Real##Vector##Isa scale = splat##Real##Isa((real)exponent);                                                 \
+    for (int k = 0; k < n; k += Real##Lanes##Isa) {                                                             \
+        Real##Vector##Isa slope = mul##Real##Isa(scale, powerVector##Real##Isa(load##Real##Isa((const real *)a + k), exponent - 1)); \
+        Real##Vector##Isa product = mul##Real##Isa(load##Real##Isa((const real *)adjoint + k), slope);          \
+        store##Real##Isa((real *)out + k, add##Real##Isa(load##Real##Isa((real *)out + k), product));           \
+    }                                                                                                           \
+}                                                                                                               \
+static Isa##Target void accumulatePowerRight##Real##Rows##Isa(void *out, const void *adjoint, const void *value, const void *a, int n) \
+{                                                                                                               \
+    for (int k = 0; k < n; k++) {                                                                               \
+        ((real *)out)[k] += ((const real *)adjoint)[k] * ((const real *)value)[k] * (real)log(((const real *)a)[k]); \
+    }                                                                                                           \
+}                                                                                                               \
+static const RowOps Real##Ops##Isa = {                                                                          \
+    sizeof(real), fill##Real##Isa, load##Real##Rows##Isa, store##Real##Rows##Isa, add##Real##Rows##Isa, subtract##Real##Rows##Isa, \
+    multiply##Real##Rows##Isa, divide##Real##Rows##Isa, negate##Real##Rows##Isa, power##Real##Rows##Isa, powerInt##Real##Rows##Isa, \
+    logarithm##Real##Rows##Isa, accumulate##Real##Rows##Isa, deduct##Real##Rows##Isa, accumulateProduct##Real##Rows##Isa, \
+    accumulateQuotient##Real##Rows##Isa, deductScaledQuotient##Real##Rows##Isa, accumulatePowerLeft##Real##Rows##Isa, \
+    accumulatePowerIntLeft##Real##Rows##Isa, accumulatePowerRight##Real##Rows##Isa                              \
+};
+
+#if defined(COLUMN_DISPATCH) || defined(__AVX512F__)
+#ifdef COLUMN_DISPATCH
+#define Avx512Target __attribute__((target("avx512f")))
+#else
+#define Avx512Target
+#endif
+typedef __m512d DoubleVectorAvx512;
+typedef __m512 FloatVectorAvx512;
+#define DoubleLanesAvx512 8
+#define FloatLanesAvx512 16
+#define loadDoubleAvx512(p) _mm512_loadu_pd(p)
+#define storeDoubleAvx512(p, v) _mm512_storeu_pd(p, v)
+#define splatDoubleAvx512(x) _mm512_set1_pd(x)
+#define addDoubleAvx512(a, b) _mm512_add_pd(a, b)
+#define subDoubleAvx512(a, b) _mm512_sub_pd(a, b)
+#define mulDoubleAvx512(a, b) _mm512_mul_pd(a, b)
+#define divDoubleAvx512(a, b) _mm512_div_pd(a, b)
+#define loadFloatAvx512(p) _mm512_loadu_ps(p)
+#define storeFloatAvx512(p, v) _mm512_storeu_ps(p, v)
+#define splatFloatAvx512(x) _mm512_set1_ps(x)
+#define addFloatAvx512(a, b) _mm512_add_ps(a, b)
+#define subFloatAvx512(a, b) _mm512_sub_ps(a, b)
+#define mulFloatAvx512(a, b) _mm512_mul_ps(a, b)
+#define divFloatAvx512(a, b) _mm512_div_ps(a, b)
+ROW_OPS(Avx512, Double, double)
+ROW_OPS(Avx512, Float, float)
+#endif
+
+#if defined(COLUMN_DISPATCH) || (defined(__AVX2__) && !defined(__AVX512F__))
+#ifdef COLUMN_DISPATCH
+#define Avx2Target __attribute__((target("avx2")))
+#else
+#define Avx2Target
+#endif
+typedef __m256d DoubleVectorAvx2;
+typedef __m256 FloatVectorAvx2;
+#define DoubleLanesAvx2 4
+#define FloatLanesAvx2 8
+#define loadDoubleAvx2(p) _mm256_loadu_pd(p)
+#define storeDoubleAvx2(p, v) _mm256_storeu_pd(p, v)
+#define splatDoubleAvx2(x) _mm256_set1_pd(x)
+#define addDoubleAvx2(a, b) _mm256_add_pd(a, b)
+#define subDoubleAvx2(a, b) _mm256_sub_pd(a, b)
+#define mulDoubleAvx2(a, b) _mm256_mul_pd(a, b)
+#define divDoubleAvx2(a, b) _mm256_div_pd(a, b)
+#define loadFloatAvx2(p) _mm256_loadu_ps(p)
+#define storeFloatAvx2(p, v) _mm256_storeu_ps(p, v)
+#define splatFloatAvx2(x) _mm256_set1_ps(x)
+#define addFloatAvx2(a, b) _mm256_add_ps(a, b)
+#define subFloatAvx2(a, b) _mm256_sub_ps(a, b)
+#define mulFloatAvx2(a, b) _mm256_mul_ps(a, b)
+#define divFloatAvx2(a, b) _mm256_div_ps(a, b)
+ROW_OPS(Avx2, Double, double)
+ROW_OPS(Avx2, Float, float)
+#endif
+
+#define ScalarTarget
+typedef double DoubleVectorScalar;
+typedef float FloatVectorScalar;
+#define DoubleLanesScalar 1
+#define FloatLanesScalar 1
+#define loadDoubleScalar(p) (*(p))
+#define storeDoubleScalar(p, v) (*(p) = (v))
+#define splatDoubleScalar(x) (x)
+#define addDoubleScalar(a, b) ((a) + (b))
+#define subDoubleScalar(a, b) ((a) - (b))
+#define mulDoubleScalar(a, b) ((a) * (b))
+#define divDoubleScalar(a, b) ((a) / (b))
+#define loadFloatScalar(p) (*(p))
+#define storeFloatScalar(p, v) (*(p) = (v))
+#define splatFloatScalar(x) (x)
+#define addFloatScalar(a, b) ((a) + (b))
+#define subFloatScalar(a, b) ((a) - (b))
+#define mulFloatScalar(a, b) ((a) * (b))
+#define divFloatScalar(a, b) ((a) / (b))
+ROW_OPS(Scalar, Double, double)
+ROW_OPS(Scalar, Float, float)
+/*pow() and log() have no vector form in the standard library, they go row by row*/
+/*the scalar operations are always there, for processors without AVX2 and for other architectures*/
+
+static const RowOps *rowOps(bool single)
+/*the widest operations the processor can run, for float or for double*/
+{
+#if defined(COLUMN_DISPATCH)
+    if (__builtin_cpu_supports("avx512f")) {
+        return single ? &FloatOpsAvx512 : &DoubleOpsAvx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return single ? &FloatOpsAvx2 : &DoubleOpsAvx2;
+    }
+#elif defined(__AVX512F__)
+    return single ? &FloatOpsAvx512 : &DoubleOpsAvx512;
+#elif defined(__AVX2__)
+    return single ? &FloatOpsAvx2 : &DoubleOpsAvx2;
+#endif
+    return single ? &FloatOpsScalar : &DoubleOpsScalar;
+}
+
+const char *columnSimdName(void) {
+    const RowOps *ops = rowOps(false);
+#if defined(COLUMN_DISPATCH) || defined(__AVX512F__)
+    if (ops == &DoubleOpsAvx512) {
+        return "AVX-512";
+    }
+#endif
+#if defined(COLUMN_DISPATCH) || (defined(__AVX2__) && !defined(__AVX512F__))
+    if (ops == &DoubleOpsAvx2) {
+        return "AVX2";
+    }
+#endif
+    return "scalar";
+}
+
+typedef struct ColumnRun {
+    const Program *program;
+    const RowOps *ops;
+    int last;
+    /*the instruction of the output, nothing after it is evaluated*/
+    int n;
+    /*rows of one block, the length of every register*/
+    char *registers, *adjoints;
+    int *exponents;
+    /*the constant exponent of every power that is multiplied out, -1 for the others*/
+    unsigned char *reached;
+    /*1 for the input slots the output depends on, the gradient of the others is zero*/
+} ColumnRun;
+
+#define REGISTER(base, run, i) ((base) + (size_t)(i) * (run)->n * (run)->ops->size)
+/*the rows of register i*/
+
+static void forwardBlock(ColumnRun *run, const void *const *columns, long first, int count)
+{
+    const Instruction *code = run->program->code;
+    const RowOps *ops = run->ops;
+    int n = run->n;
+    for (int i = 0; i <= run->last; i++) {
+        const Instruction *op = &code[i];
+        void *out = REGISTER(run->registers, run, i);
+        const void *a = op->left >= 0 ? REGISTER(run->registers, run, op->left) : NULL;
+        const void *b = op->right >= 0 ? REGISTER(run->registers, run, op->right) : NULL;
+        switch (op->operation) {
+            case 'N':
+                break;
+                /*the constants are filled in once for all the blocks*/
+            case 'V':
+                ops->load(out, columns[op->left], first, count, n);
+                break;
+            case '+':
+                ops->add(out, a, b, n);
+                break;
+            case '-':
+                ops->subtract(out, a, b, n);
+                break;
+            case '*':
+                ops->multiply(out, a, b, n);
+                break;
+            case '/':
+                ops->divide(out, a, b, n);
+                break;
+            case '^':
+                if (run->exponents[i] >= 0) {
+                    ops->powerInt(out, a, run->exponents[i], n);
+                }
+                else {
+                    ops->power(out, a, b, n);
+                }
+                break;
+            case 'l':
+                ops->logarithm(out, a, n);
+                break;
+            default:
+                ops->negate(out, a, n);
+                break;
+        }
+    }
+}
+
+static void backwardBlock(ColumnRun *run, long first, int count, void **gradient)
+/*the rules of gradientProgram() on blocks of rows*/
+{
+    const Instruction *code = run->program->code;
+    const RowOps *ops = run->ops;
+    int n = run->n;
+    memset(run->adjoints, 0, (size_t)(run->last + 1) * n * ops->size);
+    ops->fill(REGISTER(run->adjoints, run, run->last), 1, n);
+    for (int i = run->last; i >= 0; i--) {
+        const Instruction *op = &code[i];
+        const void *adjoint = REGISTER(run->adjoints, run, i);
+        const void *value = REGISTER(run->registers, run, i);
+        void *leftAdjoint = op->left >= 0 ? REGISTER(run->adjoints, run, op->left) : NULL;
+        void *rightAdjoint = op->right >= 0 ? REGISTER(run->adjoints, run, op->right) : NULL;
+        const void *a = op->left >= 0 ? REGISTER(run->registers, run, op->left) : NULL;
+        const void *b = op->right >= 0 ? REGISTER(run->registers, run, op->right) : NULL;
+        switch (op->operation) {
+            case 'V':
+                ops->store(gradient[op->left], first, adjoint, count);
+                /*a variable is one node, so this is its whole derivative*/
+                break;
+            case '+':
+                if (op->needs & 1) ops->accumulate(leftAdjoint, adjoint, n);
+                if (op->needs & 2) ops->accumulate(rightAdjoint, adjoint, n);
+                break;
+            case '-':
+                if (op->needs & 1) ops->accumulate(leftAdjoint, adjoint, n);
+                if (op->needs & 2) ops->deduct(rightAdjoint, adjoint, n);
+                break;
+            case '*':
+                if (op->needs & 1) ops->accumulateProduct(leftAdjoint, adjoint, b, n);
+                if (op->needs & 2) ops->accumulateProduct(rightAdjoint, adjoint, a, n);
+                break;
+            case '/':
+                if (op->needs & 1) ops->accumulateQuotient(leftAdjoint, adjoint, b, n);
+                if (op->needs & 2) ops->deductScaledQuotient(rightAdjoint, adjoint, value, b, n);
+                break;
+            case '^':
+                if (op->needs & 1) {
+                    if (run->exponents[i] > 0) {
+                        ops->accumulatePowerIntLeft(leftAdjoint, adjoint, a, run->exponents[i], n);
+                    }
+                    else if (run->exponents[i] < 0) {
+                        ops->accumulatePowerLeft(leftAdjoint, adjoint, a, b, n);
+                    }
+                    /*a ^ 0 is one whatever a is*/
+                }
+                if (op->needs & 2) ops->accumulatePowerRight(rightAdjoint, adjoint, value, a, n);
+                break;
+            case 'l':
+                if (op->needs & 1) ops->accumulateQuotient(leftAdjoint, adjoint, a, n);
+                break;
+            case '~':
+                if (op->needs & 1) ops->deduct(leftAdjoint, adjoint, n);
+                break;
+        }
+    }
+    for (int slot = 0; slot < run->program->inputCount; slot++) {
+        if (!run->reached[slot]) {
+            memset((char *)gradient[slot] + first * ops->size, 0, count * ops->size);
+        }
+    }
+}
+
+static void evaluateColumnsWith(const RowOps *ops, const Program *program, int output, const void *const *columns, long rows,
+                                void *values, void **gradient)
+{
+    ColumnRun run;
+    run.program = program;
+    run.ops = ops;
+    run.last = program->outputs[output];
+    size_t perRow = (size_t)(run.last + 1) * ops->size * (gradient != NULL ? 2 : 1);
+    long n = (long)(COLUMN_BLOCK_BYTES / perRow) / COLUMN_MIN_ROWS * COLUMN_MIN_ROWS;
+    /*as many rows as keep the registers of a block in the cache, the instructions are then decoded once per block*/
+    long needed = (rows + COLUMN_MIN_ROWS - 1) / COLUMN_MIN_ROWS * COLUMN_MIN_ROWS;
+    n = n > needed ? needed : n;
+    n = n > COLUMN_MAX_ROWS ? COLUMN_MAX_ROWS : n;
+    run.n = n < COLUMN_MIN_ROWS ? COLUMN_MIN_ROWS : (int)n;
+    run.registers = (char *)malloc((size_t)(run.last + 1) * run.n * ops->size);
+    run.adjoints = gradient != NULL ? (char *)malloc((size_t)(run.last + 1) * run.n * ops->size) : NULL;
+    run.exponents = (int *)malloc((run.last + 1) * sizeof(int));
+    run.reached = (unsigned char *)calloc(program->inputCount + 1, 1);
+    for (int i = 0; i <= run.last; i++) {
+        const Instruction *op = &program->code[i];
+        run.exponents[i] = -1;
+        if (op->operation == 'N') {
+            ops->fill(REGISTER(run.registers, &run, i), program->constants[op->left], run.n);
+        }
+        else if (op->operation == 'V') {
+            run.reached[op->left] = 1;
+        }
+        else if (op->operation == '^' && program->code[op->right].operation == 'N') {
+            double exponent = program->constants[program->code[op->right].left];
+            if (exponent >= 0 && exponent <= COLUMN_MAX_EXPONENT) {
+                run.exponents[i] = (int)exponent;
+            }
+        }
+    }
+    for (long first = 0; first < rows; first += run.n) {
+        int count = rows - first < run.n ? (int)(rows - first) : run.n;
+        forwardBlock(&run, columns, first, count);
+        ops->store(values, first, REGISTER(run.registers, &run, run.last), count);
+        if (gradient != NULL) {
+            backwardBlock(&run, first, count, gradient);
+        }
+    }
+    free(run.reached);
+    free(run.exponents);
+    free(run.adjoints);
+    free(run.registers);
+}
+
+void evaluateColumns(const Program *program, int output, const double *const *columns, long rows, double *values, double **gradient)
+{
+    evaluateColumnsWith(rowOps(false), program, output, (const void *const *)columns, rows, values, (void **)gradient);
+}
+
+void evaluateColumnsFloat(const Program *program, int output, const float *const *columns, long rows, float *values, float **gradient)
+{
+    evaluateColumnsWith(rowOps(true), program, output, (const void *const *)columns, rows, values, (void **)gradient);
+}
@@ -0,0 +1,305 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "header.h"
+
+/*necessary header files included*/
+
+typedef struct DatasetSlice {
+    const Program *program;
+    const double **columns;
+    double **gradient;
+    /*the columns of the chunk from the first row of the slice on*/
+    double *values;
+    int count;
+    /*rows of the slice that were read, 0 if the chunk ended before it*/
+    double *sums;
+    /*the sum of the values and then of every gradient column over the rows of the slice*/
+} DatasetSlice;
+/*the unit of work of the pool, its sums are the accumulator of whichever thread runs it*/
+
+typedef struct DatasetChunk {
+    double **columns, **gradient;
+    /*DATASET_CHUNK_ROWS rows of every input slot and of its derivative*/
+    double *values;
+    long rows;
+    /*rows read into the chunk*/
+    DatasetSlice slices[DATASET_CHUNK_ROWS / DATASET_SLICE_ROWS];
+    TaskGroup group;
+} DatasetChunk;
+/*one of the two buffers, the next chunk is read into one while the slices of the other are evaluated*/
+
+typedef struct DatasetReader {
+    FILE *file;
+    bool binary;
+    int columnCount;
+    /*number of columns of the file*/
+    int *slotOf;
+    /*the input slot of every column, -1 for a column the expression doesn't use*/
+    double *staging;
+    /*the rows of a binary chunk as they are in the file, before they are split into the columns*/
+    char *line;
+    size_t capacity;
+    long lineNumber;
+    long failures;
+    /*the rows that could not be read*/
+} DatasetReader;
+
+#define DATASET_MAGIC "GRADCOLS"
+/*the first 8 bytes of a binary file, then the header line and the rows of little-endian doubles*/
+
+static bool readHeader(DatasetReader *reader, const Program *program)
+/*the names of the columns, every input of the program needs one*/
+{
+    char magic[8];
+    reader->binary = fread(magic, 1, 8, reader->file) == 8 && memcmp(magic, DATASET_MAGIC, 8) == 0;
+    if (!reader->binary) {
+        rewind(reader->file);
+    }
+    long length = readExpression(reader->file, &reader->line, &reader->capacity);
+    if (length < 0) {
+        fprintf(stderr, "The dataset has no header\n");
+        return false;
+    }
+    reader->lineNumber = 1;
+    while (length > 0 && (reader->line[length - 1] == '\n' || reader->line[length - 1] == '\r')) {
+        reader->line[--length] = '\0';
+    }
+    bool *found = (bool *)calloc(program->inputCount + 1, sizeof(bool));
+    bool complete = true;
+    reader->slotOf = (int *)malloc((length + 2) * sizeof(int));
+    reader->columnCount = 0;
+    for (char *name = reader->line; ; ) {
+        size_t nameLength = strcspn(name, ",");
+        size_t start = strspn(name, " \t"), end = nameLength;
+        while (end > start && (name[end - 1] == ' ' || name[end - 1] == '\t')) {
+            end--;
+        }
+        int slot = programInput((Program *)program, name + start, end - start);
+        reader->slotOf[reader->columnCount++] = slot;
+        if (slot >= 0 && found[slot]) {
+            fprintf(stderr, "The dataset has the column %s twice\n", program->names[slot]);
+            complete = false;
+            /*two values for one variable, neither is the one to take*/
+        }
+        if (slot >= 0) {
+            found[slot] = true;
+        }
+        if (name[nameLength] != ',') {
+            break;
+        }
+        name += nameLength + 1;
+    }
+    for (int s = 0; s < program->inputCount; s++) {
+        if (!found[s]) {
+            fprintf(stderr, "The dataset has no column %s\n", program->names[s]);
+            complete = false;
+        }
+    }
+    free(found);
+    if (reader->binary) {
+        reader->staging = (double *)malloc((size_t)DATASET_CHUNK_ROWS * reader->columnCount * sizeof(double));
+    }
+    return complete;
+}
+
+static bool parseRow(DatasetReader *reader, DatasetChunk *chunk, long row)
+/*one line of numbers separated by commas into the columns, false if it doesn't have a number for every column*/
+{
+    char *text = reader->line;
+    for (int c = 0; c < reader->columnCount; c++) {
+        char *end;
+        double value = strtod(text, &end);
+        if (end == text) {
+            return false;
+        }
+        while (*end == ' ' || *end == '\t') {
+            end++;
+        }
+        if (c + 1 < reader->columnCount ? *end != ',' : (*end != '\0' && *end != '\n' && *end != '\r')) {
+            return false;
+        }
+        if (reader->slotOf[c] >= 0) {
+            chunk->columns[reader->slotOf[c]][row] = value;
+        }
+        text = end + 1;
+    }
+    return true;
+}
+
+static long readChunk(DatasetReader *reader, DatasetChunk *chunk)
+/*up to DATASET_CHUNK_ROWS rows of the file into the columns of the chunk, return how many*/
+{
+    long rows = 0;
+    if (reader->binary) {
+        size_t rowBytes = reader->columnCount * sizeof(double);
+        size_t bytes = fread(reader->staging, 1, rowBytes * DATASET_CHUNK_ROWS, reader->file);
+        /*read in bytes, the position after a partly read row is undefined for fread() of whole rows*/
+        rows = (long)(bytes / rowBytes);
+        if (bytes % rowBytes != 0) {
+            fprintf(stderr, "row %ld: the file ends %zu bytes into the row\n", reader->lineNumber + rows, bytes % rowBytes);
+            reader->failures++;
+            /*only the last row of the file can be cut off, the whole rows before it are still used*/
+        }
+        reader->lineNumber += rows;
+        for (int c = 0; c < reader->columnCount; c++) {
+            int slot = reader->slotOf[c];
+            if (slot < 0) {
+                continue;
+            }
+            double *column = chunk->columns[slot];
+            const double *from = reader->staging + c;
+            for (long r = 0; r < rows; r++) {
+                column[r] = from[r * reader->columnCount];
+                /*the rows become columns here, on the reading thread*/
+            }
+        }
+    }
+    else {
+        while (rows < DATASET_CHUNK_ROWS && readExpression(reader->file, &reader->line, &reader->capacity) >= 0) {
+            reader->lineNumber++;
+            if (strspn(reader->line, " \t\r\n") == strlen(reader->line)) {
+                continue;
+                /*an empty line*/
+            }
+            if (!parseRow(reader, chunk, rows)) {
+                fprintf(stderr, "line %ld: invalid row\n", reader->lineNumber);
+                reader->failures++;
+                /*report the line and go on with the next one*/
+                continue;
+            }
+            rows++;
+        }
+    }
+    chunk->rows = rows;
+    return rows;
+}
+
+static void runSlice(void *arg)
+{
+    DatasetSlice *slice = (DatasetSlice *)arg;
+    int inputs = slice->program->inputCount;
+    evaluateColumns(slice->program, 0, slice->columns, slice->count, slice->values, slice->gradient);
+    slice->sums[0] = 0;
+    for (int r = 0; r < slice->count; r++) {
+        slice->sums[0] += slice->values[r];
+    }
+    for (int s = 0; s < inputs; s++) {
+        double sum = 0;
+        for (int r = 0; r < slice->count; r++) {
+            sum += slice->gradient[s][r];
+        }
+        slice->sums[s + 1] = sum;
+    }
+}
+
+static void initChunk(DatasetChunk *chunk, const Program *program)
+{
+    int inputs = program->inputCount;
+    chunk->columns = (double **)malloc((inputs + 1) * sizeof(double *));
+    chunk->gradient = (double **)malloc((inputs + 1) * sizeof(double *));
+    for (int s = 0; s < inputs; s++) {
+        chunk->columns[s] = (double *)malloc(DATASET_CHUNK_ROWS * sizeof(double));
+        chunk->gradient[s] = (double *)malloc(DATASET_CHUNK_ROWS * sizeof(double));
+    }
+    chunk->values = (double *)malloc(DATASET_CHUNK_ROWS * sizeof(double));
+    chunk->rows = 0;
+    chunk->group.pending = 0;
+    for (int i = 0; i < DATASET_CHUNK_ROWS / DATASET_SLICE_ROWS; i++) {
+        DatasetSlice *slice = &chunk->slices[i];
+        long first = (long)i * DATASET_SLICE_ROWS;
+        slice->program = program;
+        slice->columns = (const double **)malloc((inputs + 1) * sizeof(double *));
+        slice->gradient = (double **)malloc((inputs + 1) * sizeof(double *));
+        for (int s = 0; s < inputs; s++) {
+            slice->columns[s] = chunk->columns[s] + first;
+            slice->gradient[s] = chunk->gradient[s] + first;
+        }
+        slice->values = chunk->values + first;
+        slice->sums = (double *)malloc((inputs + 1) * sizeof(double));
+        slice->count = 0;
+    }
+}
+
+static void freeChunk(DatasetChunk *chunk, const Program *program)
+{
+    for (int i = 0; i < DATASET_CHUNK_ROWS / DATASET_SLICE_ROWS; i++) {
+        free(chunk->slices[i].columns);
+        free(chunk->slices[i].gradient);
+        free(chunk->slices[i].sums);
+    }
+    for (int s = 0; s < program->inputCount; s++) {
+        free(chunk->columns[s]);
+        free(chunk->gradient[s]);
+    }
+    free(chunk->columns);
+    free(chunk->gradient);
+    free(chunk->values);
+}
+
+static void submitChunk(ThreadPool *pool, DatasetChunk *chunk)
+{
+    for (int i = 0; i < DATASET_CHUNK_ROWS / DATASET_SLICE_ROWS; i++) {
+        long first = (long)i * DATASET_SLICE_ROWS;
+        DatasetSlice *slice = &chunk->slices[i];
+        slice->count = chunk->rows > first ? (int)(chunk->rows - first < DATASET_SLICE_ROWS ? chunk->rows - first : DATASET_SLICE_ROWS) : 0;
+        if (slice->count > 0) {
+            poolSubmit(pool, &chunk->group, runSlice, slice);
+        }
+    }
+}
+
+static void reduceChunk(DatasetChunk *chunk, DatasetTotals *totals)
+/*the sums of the slices in the order of the rows, so the result doesn't depend on the threads or on which ran what*/
+{
+    for (int i = 0; i < DATASET_CHUNK_ROWS / DATASET_SLICE_ROWS && chunk->slices[i].count > 0; i++) {
+        DatasetSlice *slice = &chunk->slices[i];
+        totals->value += slice->sums[0];
+        for (int s = 0; s < totals->inputCount; s++) {
+            totals->gradient[s] += slice->sums[s + 1];
+        }
+    }
+    totals->rows += chunk->rows;
+}
+
+bool evaluateDataset(FILE *file, const Program *program, int workerCount, DatasetTotals *totals)
+{
+    DatasetReader reader;
+    memset(&reader, 0, sizeof(DatasetReader));
+    reader.file = file;
+    memset(totals, 0, sizeof(DatasetTotals));
+    totals->inputCount = program->inputCount;
+    totals->gradient = (double *)calloc(program->inputCount + 1, sizeof(double));
+    if (!readHeader(&reader, program)) {
+        free(reader.slotOf);
+        free(reader.staging);
+        free(reader.line);
+        return false;
+    }
+
+    ThreadPool *pool = createThreadPool(workerCount);
+    DatasetChunk *chunks = (DatasetChunk *)calloc(2, sizeof(DatasetChunk));
+    initChunk(&chunks[0], program);
+    initChunk(&chunks[1], program);
+    int current = 0;
+    readChunk(&reader, &chunks[current]);
+    while (chunks[current].rows > 0) {
+        submitChunk(pool, &chunks[current]);
+        DatasetChunk *next = &chunks[1 - current];
+        readChunk(&reader, next);
+        /*the workers evaluate the current chunk while the next one is read*/
+        poolWait(pool, &chunks[current].group);
+        reduceChunk(&chunks[current], totals);
+        current = 1 - current;
+    }
+    destroyThreadPool(pool);
+    freeChunk(&chunks[0], program);
+    freeChunk(&chunks[1], program);
+    free(chunks);
+    totals->failures = reader.failures;
+    free(reader.slotOf);
+    free(reader.staging);
+    free(reader.line);
+    return true;
+}
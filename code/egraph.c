@@ -0,0 +1,765 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include "header.h"
+
+/*necessary header files included*/
+
+typedef struct ENode {
+    char type;
+    /*TOKEN_IS_NUM, TOKEN_IS_VAR, TOKEN_IS_OPERATOR or TOKEN_IS_FUNCTION, '\0' once it turned out to be a duplicate*/
+    char operator;
+    int value;
+    /*the number of a number, the symbol id of a variable*/
+    int left, right;
+    /*the classes of the operands, -1 if there is none*/
+} ENode;
+/*one way to compute a class, its operands are classes and not nodes*/
+
+typedef struct EGraph {
+    ENode *nodes;
+    int count, capacity;
+    int *parent;
+    /*union-find over the node indices, a class is named by the index of its root*/
+    long long *constant;
+    unsigned char *hasConstant;
+    /*the value of the classes that are an integer constant, kept at the root*/
+    int *table;
+    /*open addressing from a node to its index + 1, 0 for an empty slot*/
+    int tableSize;
+    int *memberStart, *members;
+    /*the nodes of every class, members[memberStart[c]] up to memberStart[c + 1], rebuilt before every round*/
+    const OptimizeBudget *budget;
+    double deadline;
+    bool changed;
+    bool exhausted;
+    /*the node or the time budget is used up, no more nodes are added*/
+} EGraph;
+/*an e-graph: classes of expressions that are known to be equal, so every rewrite only adds and nothing is lost*/
+
+static double nowMilliseconds(void)
+{
+#ifdef _WIN32
+    return (double)GetTickCount64();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+#endif
+}
+
+static int findClass(EGraph *graph, int id)
+{
+    while (graph->parent[id] != id) {
+        graph->parent[id] = graph->parent[graph->parent[id]];
+        id = graph->parent[id];
+        /*path halving keeps the chains short*/
+    }
+    return id;
+}
+
+static unsigned int hashENode(ENode *node)
+{
+    unsigned int hash = 2166136261u;
+    hash = (hash ^ (unsigned char)node->type) * 16777619u;
+    hash = (hash ^ (unsigned char)node->operator) * 16777619u;
+    hash = (hash ^ (unsigned int)node->value) * 16777619u;
+    hash = (hash ^ (unsigned int)(node->left + 1)) * 16777619u;
+    hash = (hash ^ (unsigned int)(node->right + 1)) * 16777619u;
+    return hash;
+}
+
+static bool sameENode(ENode *a, ENode *b)
+{
+    return a->type == b->type && a->operator == b->operator && a->value == b->value && a->left == b->left && a->right == b->right;
+}
+
+static int lookupENode(EGraph *graph, ENode *node, bool insert, int index)
+/*the index of the node with the same features, or -1 after inserting index (if insert is set)*/
+{
+    unsigned int slot = hashENode(node) & (graph->tableSize - 1);
+    while (graph->table[slot] != 0) {
+        int other = graph->table[slot] - 1;
+        if (sameENode(&graph->nodes[other], node)) {
+            return other;
+        }
+        slot = (slot + 1) & (graph->tableSize - 1);
+    }
+    if (insert) {
+        graph->table[slot] = index + 1;
+    }
+    return -1;
+}
+
+static void clearTable(EGraph *graph, int minimum)
+{
+    int size = graph->tableSize ? graph->tableSize : 1024;
+    while (size < 2 * minimum) {
+        size *= 2;
+        /*at most half full, so the probes stay short*/
+    }
+    if (size != graph->tableSize) {
+        free(graph->table);
+        graph->table = (int *)malloc(size * sizeof(int));
+        graph->tableSize = size;
+    }
+    memset(graph->table, 0, size * sizeof(int));
+}
+
+static bool foldConstant(ENode *node, long long a, long long b, long long *value)
+/*the value of the node from the values of its operands, false if it is not an integer that fits*/
+{
+    if (node->type == TOKEN_IS_FUNCTION) {
+        if (node->operator != '-') {
+            return false;
+        }
+        *value = -a;
+        return true;
+    }
+    switch (node->operator) {
+        case '+':
+            *value = a + b;
+            break;
+        case '-':
+            *value = a - b;
+            break;
+        case '*':
+            if (a != 0 && (b > INT_MAX || b < -(long long)INT_MAX || a > INT_MAX || a < -(long long)INT_MAX)) {
+                return false;
+            }
+            *value = a * b;
+            break;
+        default:
+            return false;
+            /*quotients and powers are folded by the simplifier, they rarely stay integers*/
+    }
+    return *value <= INT_MAX && *value >= -(long long)INT_MAX;
+}
+
+static int addENode(EGraph *graph, char type, char operation, int value, int left, int right);
+
+static void mergeClasses(EGraph *graph, int a, int b)
+{
+    if (a < 0 || b < 0) {
+        return;
+        /*a rewrite that ran out of budget*/
+    }
+    a = findClass(graph, a);
+    b = findClass(graph, b);
+    if (a == b) {
+        return;
+    }
+    if (b < a) {
+        int swap = a;
+        a = b;
+        b = swap;
+    }
+    graph->parent[b] = a;
+    /*the older class stays the root*/
+    if (!graph->hasConstant[a] && graph->hasConstant[b]) {
+        graph->hasConstant[a] = 1;
+        graph->constant[a] = graph->constant[b];
+    }
+    graph->changed = true;
+}
+
+static int addConstant(EGraph *graph, long long value)
+/*the class of the integer, negative values are the negation of a number as in the node store*/
+{
+    if (value >= 0) {
+        return addENode(graph, TOKEN_IS_NUM, '\0', (int)value, -1, -1);
+    }
+    return addENode(graph, TOKEN_IS_FUNCTION, '-', 0, addENode(graph, TOKEN_IS_NUM, '\0', (int)-value, -1, -1), -1);
+}
+
+static bool isConstantLeaf(EGraph *graph, ENode *node)
+{
+    return node->type == TOKEN_IS_NUM
+        || (node->type == TOKEN_IS_FUNCTION && node->operator == '-' && graph->nodes[node->left].type == TOKEN_IS_NUM);
+}
+
+static void noteConstant(EGraph *graph, int index)
+/*if the operands of the node are constants, its class is that constant and gets the number as a member*/
+{
+    ENode *node = &graph->nodes[index];
+    int cls = findClass(graph, index);
+    if (graph->hasConstant[cls] || node->type == TOKEN_IS_VAR) {
+        return;
+    }
+    long long value;
+    if (node->type == TOKEN_IS_NUM) {
+        value = node->value;
+    }
+    else {
+        int left = findClass(graph, node->left);
+        int right = node->right >= 0 ? findClass(graph, node->right) : -1;
+        if (!graph->hasConstant[left] || (right >= 0 && !graph->hasConstant[right])) {
+            return;
+        }
+        if (!foldConstant(node, graph->constant[left], right >= 0 ? graph->constant[right] : 0, &value)) {
+            return;
+        }
+    }
+    graph->hasConstant[cls] = 1;
+    graph->constant[cls] = value;
+    if (!isConstantLeaf(graph, node)) {
+        mergeClasses(graph, cls, addConstant(graph, value));
+        /*the leaf itself is already in the table, so this goes one level deep*/
+    }
+}
+
+static int addENode(EGraph *graph, char type, char operation, int value, int left, int right)
+/*the class of the node, a new class if the node is new, -2 if an operand is missing or the budget is used up*/
+{
+    if (left == -2 || right == -2 || (type == TOKEN_IS_OPERATOR && (left < 0 || right < 0)) || (type == TOKEN_IS_FUNCTION && left < 0)) {
+        return -2;
+    }
+    ENode node = {type, operation, value, left >= 0 ? findClass(graph, left) : -1, right >= 0 ? findClass(graph, right) : -1};
+    int found = lookupENode(graph, &node, false, 0);
+    if (found >= 0) {
+        return findClass(graph, found);
+    }
+    if (graph->count >= graph->budget->nodes) {
+        graph->exhausted = true;
+        return -2;
+    }
+    if (graph->count == graph->capacity) {
+        graph->capacity = graph->capacity ? graph->capacity * 2 : 256;
+        graph->nodes = (ENode *)realloc(graph->nodes, graph->capacity * sizeof(ENode));
+        graph->parent = (int *)realloc(graph->parent, graph->capacity * sizeof(int));
+        graph->constant = (long long *)realloc(graph->constant, graph->capacity * sizeof(long long));
+        graph->hasConstant = (unsigned char *)realloc(graph->hasConstant, graph->capacity);
+    }
+    if (2 * (graph->count + 1) > graph->tableSize) {
+        clearTable(graph, graph->count + 1);
+        for (int i = 0; i < graph->count; i++) {
+            if (graph->nodes[i].type != '\0') {
+                lookupENode(graph, &graph->nodes[i], true, i);
+            }
+        }
+        /*the table is rebuilt bigger, duplicates that are waiting for the next rebuild simply share a slot chain*/
+    }
+    int index = graph->count++;
+    graph->nodes[index] = node;
+    graph->parent[index] = index;
+    graph->hasConstant[index] = 0;
+    lookupENode(graph, &node, true, index);
+    graph->changed = true;
+    noteConstant(graph, index);
+    return findClass(graph, index);
+}
+
+static void rebuild(EGraph *graph)
+/*restore the invariants after merging: operands point at roots, equal nodes are one node, and the member lists are fresh*/
+{
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        clearTable(graph, graph->count);
+        for (int i = 0; i < graph->count; i++) {
+            ENode *node = &graph->nodes[i];
+            if (node->type == '\0') {
+                continue;
+            }
+            if (node->left >= 0) {
+                node->left = findClass(graph, node->left);
+            }
+            if (node->right >= 0) {
+                node->right = findClass(graph, node->right);
+            }
+            int other = lookupENode(graph, node, true, i);
+            if (other >= 0) {
+                if (findClass(graph, other) != findClass(graph, i)) {
+                    mergeClasses(graph, other, i);
+                    merged = true;
+                    /*congruence: the same operator on the same classes is the same class*/
+                }
+                node->type = '\0';
+                /*the node is a duplicate of other, it is left out from now on*/
+            }
+        }
+        for (int i = 0, count = graph->count; i < count; i++) {
+            if (graph->nodes[i].type != '\0') {
+                noteConstant(graph, i);
+                /*a merge can make the operands of a node constant*/
+            }
+        }
+    }
+    graph->memberStart = (int *)realloc(graph->memberStart, (graph->count + 1) * sizeof(int));
+    graph->members = (int *)realloc(graph->members, (graph->count + 1) * sizeof(int));
+    memset(graph->memberStart, 0, (graph->count + 1) * sizeof(int));
+    for (int i = 0; i < graph->count; i++) {
+        if (graph->nodes[i].type != '\0') {
+            graph->memberStart[findClass(graph, i) + 1]++;
+        }
+    }
+    for (int i = 0; i < graph->count; i++) {
+        graph->memberStart[i + 1] += graph->memberStart[i];
+    }
+    int *fill = (int *)malloc((graph->count + 1) * sizeof(int));
+    memcpy(fill, graph->memberStart, (graph->count + 1) * sizeof(int));
+    for (int i = 0; i < graph->count; i++) {
+        if (graph->nodes[i].type != '\0') {
+            graph->members[fill[findClass(graph, i)]++] = i;
+        }
+    }
+    free(fill);
+}
+
+static bool classConstant(EGraph *graph, int cls, long long value)
+{
+    cls = findClass(graph, cls);
+    return graph->hasConstant[cls] && graph->constant[cls] == value;
+}
+
+static int addOperator(EGraph *graph, char op, int left, int right) {
+    return addENode(graph, TOKEN_IS_OPERATOR, op, 0, left, right);
+}
+
+static int addNegation(EGraph *graph, int operand) {
+    return addENode(graph, TOKEN_IS_FUNCTION, '-', 0, operand, -1);
+}
+
+#define FOR_MEMBERS(graph, cls, member) \
+    for (int member##At = (graph)->memberStart[cls], member = -1; \
+         member##At < (graph)->memberStart[(cls) + 1] && ((member = (graph)->members[member##At]), true); member##At++)
+/*every node of a class as it was at the last rebuild*/
+
+static bool isOperatorNode(ENode *node, char op) {
+    return node->type == TOKEN_IS_OPERATOR && node->operator == op;
+}
+
+static void rewriteSum(EGraph *graph, int cls, ENode *node)
+/*the rules for a + b and a - b*/
+{
+    int a = node->left, b = node->right;
+    char op = node->operator;
+    if (op == '+') {
+        mergeClasses(graph, cls, addOperator(graph, '+', b, a));
+        /*a + b = b + a*/
+        FOR_MEMBERS(graph, a, p) {
+            ENode inner = graph->nodes[p];
+            if (isOperatorNode(&inner, '+')) {
+                mergeClasses(graph, cls, addOperator(graph, '+', inner.left, addOperator(graph, '+', inner.right, b)));
+                /*(p + q) + b = p + (q + b)*/
+            }
+        }
+        if (findClass(graph, a) == findClass(graph, b)) {
+            mergeClasses(graph, cls, addOperator(graph, '*', addConstant(graph, 2), a));
+            /*x + x = 2 * x*/
+        }
+    }
+    if (classConstant(graph, b, 0)) {
+        mergeClasses(graph, cls, a);
+    }
+    if (op == '+' && classConstant(graph, a, 0)) {
+        mergeClasses(graph, cls, b);
+    }
+    if (op == '-' && classConstant(graph, a, 0)) {
+        mergeClasses(graph, cls, addNegation(graph, b));
+    }
+    if (op == '-' && findClass(graph, a) == findClass(graph, b)) {
+        mergeClasses(graph, cls, addConstant(graph, 0));
+    }
+    FOR_MEMBERS(graph, b, q) {
+        ENode right = graph->nodes[q];
+        if (right.type == TOKEN_IS_FUNCTION && right.operator == '-') {
+            mergeClasses(graph, cls, addOperator(graph, op == '+' ? '-' : '+', a, right.left));
+            /*a + (-q) = a - q and a - (-q) = a + q*/
+        }
+    }
+    FOR_MEMBERS(graph, a, p) {
+        ENode left = graph->nodes[p];
+        if (left.type != TOKEN_IS_OPERATOR || (left.operator != '*' && left.operator != '/')) {
+            continue;
+        }
+        FOR_MEMBERS(graph, b, q) {
+            ENode right = graph->nodes[q];
+            if (right.type != TOKEN_IS_OPERATOR || right.operator != left.operator) {
+                continue;
+            }
+            if (left.operator == '*' && findClass(graph, left.left) == findClass(graph, right.left)) {
+                mergeClasses(graph, cls, addOperator(graph, '*', left.left, addOperator(graph, op, left.right, right.right)));
+                /*x * y + x * z = x * (y + z), the factoring that undoes the product rule*/
+            }
+            if (findClass(graph, left.right) == findClass(graph, right.right)) {
+                mergeClasses(graph, cls, addOperator(graph, left.operator, addOperator(graph, op, left.left, right.left), left.right));
+                /*y * x + z * x = (y + z) * x and y / x + z / x = (y + z) / x*/
+            }
+        }
+    }
+}
+
+static void rewriteProduct(EGraph *graph, int cls, ENode *node)
+{
+    int a = node->left, b = node->right;
+    mergeClasses(graph, cls, addOperator(graph, '*', b, a));
+    /*a * b = b * a*/
+    if (classConstant(graph, a, 1)) {
+        mergeClasses(graph, cls, b);
+    }
+    if (classConstant(graph, a, 0)) {
+        mergeClasses(graph, cls, a);
+    }
+    if (findClass(graph, a) == findClass(graph, b)) {
+        mergeClasses(graph, cls, addOperator(graph, '^', a, addConstant(graph, 2)));
+        /*x * x = x ^ 2*/
+    }
+    FOR_MEMBERS(graph, a, p) {
+        ENode left = graph->nodes[p];
+        if (isOperatorNode(&left, '*')) {
+            mergeClasses(graph, cls, addOperator(graph, '*', left.left, addOperator(graph, '*', left.right, b)));
+            /*(p * q) * b = p * (q * b)*/
+        }
+        else if (isOperatorNode(&left, '/')) {
+            mergeClasses(graph, cls, addOperator(graph, '/', addOperator(graph, '*', left.left, b), left.right));
+            /*(p / q) * b = (p * b) / q*/
+        }
+        else if (left.type == TOKEN_IS_FUNCTION && left.operator == '-') {
+            mergeClasses(graph, cls, addNegation(graph, addOperator(graph, '*', left.left, b)));
+        }
+        else if (isOperatorNode(&left, '^')) {
+            if (findClass(graph, left.left) == findClass(graph, b)) {
+                mergeClasses(graph, cls, addOperator(graph, '^', b, addOperator(graph, '+', left.right, addConstant(graph, 1))));
+                /*x ^ n * x = x ^ (n + 1)*/
+            }
+            FOR_MEMBERS(graph, b, q) {
+                ENode right = graph->nodes[q];
+                if (isOperatorNode(&right, '^') && findClass(graph, left.left) == findClass(graph, right.left)) {
+                    mergeClasses(graph, cls, addOperator(graph, '^', left.left, addOperator(graph, '+', left.right, right.right)));
+                    /*x ^ m * x ^ n = x ^ (m + n), for a positive x like every logarithm of the derivatives assumes*/
+                }
+            }
+        }
+    }
+    FOR_MEMBERS(graph, b, q) {
+        ENode right = graph->nodes[q];
+        if (isOperatorNode(&right, '+') || isOperatorNode(&right, '-')) {
+            mergeClasses(graph, cls, addOperator(graph, right.operator, addOperator(graph, '*', a, right.left),
+                                                 addOperator(graph, '*', a, right.right)));
+            /*a * (p + q) = a * p + a * q, the extraction keeps whichever is cheaper*/
+        }
+    }
+}
+
+static void rewriteQuotient(EGraph *graph, int cls, ENode *node)
+{
+    int a = node->left, b = node->right;
+    if (classConstant(graph, b, 1)) {
+        mergeClasses(graph, cls, a);
+    }
+    if (findClass(graph, a) == findClass(graph, b)) {
+        mergeClasses(graph, cls, addConstant(graph, 1));
+        /*the same assumption as the simplifier, an expression divided by itself is one*/
+    }
+    FOR_MEMBERS(graph, a, p) {
+        ENode left = graph->nodes[p];
+        if (isOperatorNode(&left, '*')) {
+            if (findClass(graph, left.left) == findClass(graph, b)) {
+                mergeClasses(graph, cls, left.right);
+            }
+            if (findClass(graph, left.right) == findClass(graph, b)) {
+                mergeClasses(graph, cls, left.left);
+            }
+            mergeClasses(graph, cls, addOperator(graph, '*', left.left, addOperator(graph, '/', left.right, b)));
+            /*(p * q) / b = p * (q / b)*/
+        }
+        else if (isOperatorNode(&left, '/')) {
+            mergeClasses(graph, cls, addOperator(graph, '/', left.left, addOperator(graph, '*', left.right, b)));
+            /*(p / q) / b = p / (q * b)*/
+        }
+        else if (isOperatorNode(&left, '+') || isOperatorNode(&left, '-')) {
+            mergeClasses(graph, cls, addOperator(graph, left.operator, addOperator(graph, '/', left.left, b),
+                                                 addOperator(graph, '/', left.right, b)));
+            /*(p - q) / b = p / b - q / b, which takes the quotient rule apart*/
+        }
+        else if (left.type == TOKEN_IS_FUNCTION && left.operator == '-') {
+            mergeClasses(graph, cls, addNegation(graph, addOperator(graph, '/', left.left, b)));
+        }
+        else if (isOperatorNode(&left, '^')) {
+            if (findClass(graph, left.left) == findClass(graph, b)) {
+                mergeClasses(graph, cls, addOperator(graph, '^', b, addOperator(graph, '-', left.right, addConstant(graph, 1))));
+                /*x ^ n / x = x ^ (n - 1), what the rule for powers needs*/
+            }
+            FOR_MEMBERS(graph, b, q) {
+                ENode right = graph->nodes[q];
+                if (isOperatorNode(&right, '^') && findClass(graph, left.left) == findClass(graph, right.left)) {
+                    mergeClasses(graph, cls, addOperator(graph, '^', left.left, addOperator(graph, '-', left.right, right.right)));
+                }
+            }
+        }
+    }
+}
+
+static void rewritePower(EGraph *graph, int cls, ENode *node)
+{
+    int a = node->left, b = node->right;
+    if (classConstant(graph, b, 1)) {
+        mergeClasses(graph, cls, a);
+    }
+    if (classConstant(graph, b, 0)) {
+        mergeClasses(graph, cls, addConstant(graph, 1));
+    }
+    int exponent = findClass(graph, b);
+    if (!graph->hasConstant[exponent]) {
+        return;
+    }
+    FOR_MEMBERS(graph, a, p) {
+        ENode left = graph->nodes[p];
+        if (isOperatorNode(&left, '^') && graph->hasConstant[findClass(graph, left.right)]) {
+            mergeClasses(graph, cls, addOperator(graph, '^', left.left, addOperator(graph, '*', left.right, b)));
+            /*(x ^ m) ^ n = x ^ (m * n), only for integer exponents*/
+        }
+    }
+}
+
+static void rewriteNegation(EGraph *graph, int cls, ENode *node)
+{
+    FOR_MEMBERS(graph, node->left, p) {
+        ENode inner = graph->nodes[p];
+        if (inner.type == TOKEN_IS_FUNCTION && inner.operator == '-') {
+            mergeClasses(graph, cls, inner.left);
+            /*-(-x) = x*/
+        }
+        else if (isOperatorNode(&inner, '-')) {
+            mergeClasses(graph, cls, addOperator(graph, '-', inner.right, inner.left));
+            /*-(p - q) = q - p*/
+        }
+        else if (isOperatorNode(&inner, '*') || isOperatorNode(&inner, '/')) {
+            mergeClasses(graph, cls, addOperator(graph, inner.operator, addNegation(graph, inner.left), inner.right));
+            /*the negation can go on either factor*/
+        }
+    }
+}
+
+static void applyRules(EGraph *graph, int index)
+/*add every form the rules give for the node to its class*/
+{
+    ENode node = graph->nodes[index];
+    /*a copy, adding nodes can move the array*/
+    int cls = findClass(graph, index);
+    if (node.type == TOKEN_IS_FUNCTION) {
+        if (node.operator == '-') {
+            rewriteNegation(graph, cls, &node);
+        }
+        return;
+    }
+    if (node.type != TOKEN_IS_OPERATOR) {
+        return;
+    }
+    switch (node.operator) {
+        case '+':
+        case '-':
+            rewriteSum(graph, cls, &node);
+            break;
+        case '*':
+            rewriteProduct(graph, cls, &node);
+            break;
+        case '/':
+            rewriteQuotient(graph, cls, &node);
+            break;
+        case '^':
+            rewritePower(graph, cls, &node);
+            break;
+    }
+}
+
+static double nodeCost(ENode *node, char model)
+/*the cost of evaluating the node itself, every node costs one when the nodes are counted*/
+{
+    if (model == 'n' || node->type == TOKEN_IS_NUM || node->type == TOKEN_IS_VAR) {
+        return 1;
+    }
+    if (node->type == TOKEN_IS_FUNCTION) {
+        return node->operator == 'l' ? 20 : 1;
+    }
+    switch (node->operator) {
+        case '*':
+            return 2;
+        case '/':
+            return 8;
+        case '^':
+            return 20;
+            /*pow() and log() are an order of magnitude slower than the arithmetic*/
+    }
+    return 1;
+}
+
+static Node **extract(EGraph *graph, int *roots, int count)
+/*the cheapest node of every class under the cost model, and the trees it gives for the roots*/
+{
+    double *best = (double *)malloc(graph->count * sizeof(double));
+    int *choice = (int *)malloc(graph->count * sizeof(int));
+    for (int i = 0; i < graph->count; i++) {
+        best[i] = INFINITY;
+        choice[i] = -1;
+    }
+    bool improved = true;
+    while (improved)
+    /*relax until nothing improves, every choice is cheaper than its parent so the choices never form a cycle*/
+    {
+        improved = false;
+        for (int i = 0; i < graph->count; i++) {
+            ENode *node = &graph->nodes[i];
+            if (node->type == '\0') {
+                continue;
+            }
+            double cost = nodeCost(node, graph->budget->cost);
+            if (node->left >= 0) {
+                cost += best[findClass(graph, node->left)];
+            }
+            if (node->right >= 0) {
+                cost += best[findClass(graph, node->right)];
+            }
+            int cls = findClass(graph, i);
+            if (cost < best[cls]) {
+                best[cls] = cost;
+                choice[cls] = i;
+                improved = true;
+            }
+        }
+    }
+
+    Node **built = (Node **)calloc(graph->count, sizeof(Node *));
+    Node **result = (Node **)malloc(count * sizeof(Node *));
+    int capacity = 64, top = 0;
+    int *stack = (int *)malloc(capacity * sizeof(int));
+    for (int r = 0; r < count; r++) {
+        stack[top++] = findClass(graph, roots[r]);
+        while (top > 0) {
+            int cls = stack[top - 1];
+            if (built[cls] != NULL) {
+                top--;
+                continue;
+            }
+            ENode *node = &graph->nodes[choice[cls]];
+            int left = node->left >= 0 ? findClass(graph, node->left) : -1;
+            int right = node->right >= 0 ? findClass(graph, node->right) : -1;
+            if ((left >= 0 && built[left] == NULL) || (right >= 0 && built[right] == NULL)) {
+                if (top + 2 > capacity) {
+                    capacity *= 2;
+                    stack = (int *)realloc(stack, capacity * sizeof(int));
+                }
+                if (right >= 0 && built[right] == NULL) {
+                    stack[top++] = right;
+                }
+                if (left >= 0 && built[left] == NULL) {
+                    stack[top++] = left;
+                }
+                continue;
+            }
+            if (node->type == TOKEN_IS_NUM) {
+                built[cls] = createNode(TOKEN_IS_NUM, '\0', node->value, -1);
+            }
+            else if (node->type == TOKEN_IS_VAR) {
+                built[cls] = internNode(TOKEN_IS_VAR, '\0', 0, node->value, NULL, NULL);
+            }
+            else {
+                built[cls] = internNode(node->type, node->operator, 0, -1, built[left], right >= 0 ? built[right] : NULL);
+            }
+            top--;
+        }
+        result[r] = built[findClass(graph, roots[r])];
+    }
+    free(stack);
+    free(built);
+    free(choice);
+    free(best);
+    return result;
+}
+
+static void freeEGraph(EGraph *graph)
+{
+    free(graph->nodes);
+    free(graph->parent);
+    free(graph->constant);
+    free(graph->hasConstant);
+    free(graph->table);
+    free(graph->memberStart);
+    free(graph->members);
+}
+
+static bool outOfBudget(EGraph *graph)
+{
+    if (!graph->exhausted && graph->budget->milliseconds > 0 && nowMilliseconds() > graph->deadline) {
+        graph->exhausted = true;
+    }
+    return graph->exhausted;
+}
+
+void optimizeAll(Node **roots, int count, const OptimizeBudget *budget)
+{
+    if (budget == NULL || budget->nodes <= 0 || count == 0) {
+        return;
+    }
+    EGraph graph;
+    memset(&graph, 0, sizeof(EGraph));
+    graph.budget = budget;
+    graph.deadline = nowMilliseconds() + budget->milliseconds;
+    clearTable(&graph, 0);
+
+    int top = largestId(roots, count);
+    unsigned char *reachable = (unsigned char *)calloc(top + 1, 1);
+    markReachable(currentNodeStore(), roots, count, reachable);
+    int *classOf = (int *)malloc((top + 1) * sizeof(int));
+    NodeStore *store = currentNodeStore();
+    bool seeded = true;
+    for (int id = 0; id <= top && seeded; id++)
+    /*the ids are a topological order, so the operands are in the graph before the node*/
+    {
+        if (!reachable[id]) {
+            continue;
+        }
+        Node *node = store->nodes[id];
+        int left = node->Left != NULL ? classOf[node->Left->id] : -1;
+        int right = node->Right != NULL ? classOf[node->Right->id] : -1;
+        classOf[id] = addENode(&graph, node->type, node->operator,
+                               node->type == TOKEN_IS_VAR ? node->symbol : node->number, left, right);
+        seeded = classOf[id] >= 0;
+    }
+    free(reachable);
+    if (!seeded) {
+        free(classOf);
+        freeEGraph(&graph);
+        return;
+        /*the derivatives alone are bigger than the budget, they are left as the simplifier made them*/
+    }
+    int *rootClasses = (int *)malloc(count * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        rootClasses[i] = classOf[roots[i]->id];
+    }
+    free(classOf);
+
+    rebuild(&graph);
+    for (int round = 0; round < budget->rounds && !outOfBudget(&graph); round++)
+    /*rounds of rewriting until nothing new turns up (saturation) or the budget is used up*/
+    {
+        graph.changed = false;
+        int known = graph.count;
+        for (int i = 0; i < known && !graph.exhausted; i++) {
+            if (graph.nodes[i].type != '\0') {
+                applyRules(&graph, i);
+            }
+            if ((i & 255) == 255) {
+                outOfBudget(&graph);
+            }
+        }
+        rebuild(&graph);
+        if (!graph.changed) {
+            break;
+        }
+    }
+    Node **optimized = extract(&graph, rootClasses, count);
+    memcpy(roots, optimized, count * sizeof(Node *));
+    free(optimized);
+    free(rootClasses);
+    freeEGraph(&graph);
+}
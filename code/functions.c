@@ -4,96 +4,298 @@
 #include <ctype.h>
 #include <stdarg.h>
 #include <string.h>
+#include <limits.h>
 #include "header.h"
 
 /*necessary header files included*/
 
-Node *createNode(char type, char operation, int number, char *variable) {
-    Node *tempNode = (Node *)calloc(1, sizeof(Node));
+static THREAD_LOCAL NodeStore nodeStore = {NULL, 0, 0, NULL, NULL, NULL, 0};
+/*the store that owns every node, so identical subexpressions are built only once*/
+static THREAD_LOCAL SymbolTable symbols = {NULL, NULL, NULL, NULL, 0, 0, 0};
+/*the variable names of the expression, the nodes only keep their ids*/
+static THREAD_LOCAL Arena exprArena = {NULL, NULL, 0};
+/*nodes, buckets and strings of the current expression all come from here*/
+static THREAD_LOCAL TokenList threadTokens;
+/*every thread works on its own expression, so none of the three is shared between threads*/
+static ThreadPool *gradPool = NULL;
+/*the pool that parseExpression() and calculateGrad() hand their work to, NULL to do it all on the calling thread*/
+static const OptimizeBudget *gradOptimizer = NULL;
+/*the budget of the optimizer that calculateGrad() runs on the derivatives, NULL to skip it*/
+
+TokenList *threadTokenList(void) {
+    return &threadTokens;
+}
+
+void releaseThreadMemory(void) {
+    releaseExpression();
+    arenaDestroy(&exprArena);
+    freeTokenList(&threadTokens);
+    /*called by a thread that is about to exit*/
+}
+
+Arena *expressionArena(void) {
+    return &exprArena;
+}
+
+static unsigned int hashNode(char type, char operation, int number, int symbol, Node *left, Node *right)
+/*mix every feature of the node into one hash value*/
+{
+    unsigned int hash = 2166136261u;
+    hash = (hash ^ (unsigned char)type) * 16777619u;
+    hash = (hash ^ (unsigned char)operation) * 16777619u;
+    hash = (hash ^ (unsigned int)number) * 16777619u;
+    hash = (hash ^ (unsigned int)(symbol + 1)) * 16777619u;
+    /*a variable is identified by its symbol id, the name was hashed once when it was interned*/
+    hash = (hash ^ (unsigned int)(left ? left->id + 1 : 0)) * 16777619u;
+    hash = (hash ^ (unsigned int)(right ? right->id + 1 : 0)) * 16777619u;
+    /*the children are identified by their ids, which are unique in the store*/
+    return hash;
+}
+
+static void growNodeStore(void)
+/*double the buckets and rehash the chains when the load factor reaches one*/
+{
+    int newCount = nodeStore.bucketCount ? nodeStore.bucketCount * 2 : 1024;
+    Node **newBuckets = (Node **)arenaCalloc(&exprArena, newCount, sizeof(Node *));
+    for (int i = 0; i < nodeStore.bucketCount; i++) {
+        Node *node = nodeStore.buckets[i];
+        while (node != NULL) {
+            Node *next = node->next;
+            unsigned int slot = hashNode(node->type, node->operator, node->number, node->symbol, node->Left, node->Right) & (newCount - 1);
+            node->next = newBuckets[slot];
+            newBuckets[slot] = node;
+            node = next;
+        }
+    }
+    nodeStore.buckets = newBuckets;
+    /*the old buckets stay in the arena until the expression is released*/
+    nodeStore.bucketCount = newCount;
+}
+
+Node *internNode(char type, char operation, int number, int symbol, Node *left, Node *right) {
+    if (nodeStore.count >= nodeStore.bucketCount) {
+        growNodeStore();
+    }
+    unsigned int slot = hashNode(type, operation, number, symbol, left, right) & (nodeStore.bucketCount - 1);
+    for (Node *node = nodeStore.buckets[slot]; node != NULL; node = node->next) {
+        if (node->type == type && node->operator == operation && node->number == number && node->symbol == symbol
+            && node->Left == left && node->Right == right) {
+            return node;
+            /*the subexpression already exists, share it*/
+        }
+    }
+
+    Node *tempNode = (Node *)arenaCalloc(&exprArena, 1, sizeof(Node));
     /*malloc memory for the node*/
     tempNode->type = type;
     tempNode->operator = operation;
     tempNode->number = number;
+    tempNode->symbol = symbol;
     /*assign basic information of the node*/
-
-    strcpy(tempNode->variable, "");
-    /*initialize the tempNode*/
-    if (variable != NULL) {
-        strcpy(tempNode->variable, variable);
-        /*if the variable is not empty, then initialize the variable*/
-    }
-
     tempNode->Left = NULL;
     tempNode->Right = NULL;
-    tempNode->Parent = NULL;
-    /*set to NULL first, later we would use */
-
+    tempNode->size = 1;
+    if (left != NULL) {
+        setChildren(tempNode, left, right);
+        long size = 1L + left->size + (right != NULL ? right->size : 0);
+        tempNode->size = size > INT_MAX ? INT_MAX : (int)size;
+        /*sharing can make the tree exponentially larger than the store, so the count saturates*/
+    }
+    if (nodeStore.count == nodeStore.capacity) {
+        int newCapacity = nodeStore.capacity ? nodeStore.capacity * 2 : 1024;
+        PackedNode *packed = (PackedNode *)arenaAlloc(&exprArena, newCapacity * sizeof(PackedNode));
+        Node **nodes = (Node **)arenaAlloc(&exprArena, newCapacity * sizeof(Node *));
+        unsigned long long *depends = (unsigned long long *)arenaAlloc(&exprArena, newCapacity * sizeof(unsigned long long));
+        if (nodeStore.count > 0) {
+            memcpy(packed, nodeStore.packed, nodeStore.count * sizeof(PackedNode));
+            memcpy(nodes, nodeStore.nodes, nodeStore.count * sizeof(Node *));
+            memcpy(depends, nodeStore.depends, nodeStore.count * sizeof(unsigned long long));
+        }
+        nodeStore.packed = packed;
+        nodeStore.nodes = nodes;
+        nodeStore.depends = depends;
+        nodeStore.capacity = newCapacity;
+        /*double the arrays when they are full, the old ones stay in the arena*/
+    }
+    tempNode->id = nodeStore.count++;
+    PackedNode *packed = &nodeStore.packed[tempNode->id];
+    packed->tag = PACKED_TAG(type, operation);
+    packed->left = left != NULL ? left->id : -1;
+    packed->right = right != NULL ? right->id : -1;
+    packed->operand.number = number;
+    if (type == TOKEN_IS_VAR) {
+        packed->operand.symbol = symbol;
+    }
+    nodeStore.nodes[tempNode->id] = tempNode;
+    /*the packed copy is what the traversals read, the node is kept for its cached expression*/
+    nodeStore.depends[tempNode->id] = type == TOKEN_IS_VAR ? SYMBOL_BIT(symbol)
+        : (left != NULL ? nodeStore.depends[left->id] : 0) | (right != NULL ? nodeStore.depends[right->id] : 0);
+    /*the children are always built first, so the sets are filled bottom-up as the tree is built*/
+    tempNode->next = nodeStore.buckets[slot];
+    nodeStore.buckets[slot] = tempNode;
+    /*link the new node into its bucket*/
     return tempNode;
 }
 
-bool isOperator(char c) {
-    return (c == '+' || c == '-' || c == '*' || c == '/' || c == '^');
-    /*implement the judgement of operators*/
+Node *createNode(char type, char operation, int number, int symbol) {
+    return internNode(type, operation, number, symbol, NULL, NULL);
+    /*leaves go through the store as well, so every x in the expression is the same node*/
 }
 
-void tokenize(char *expression, TokenList *tokenListPtr) {
-    int expressionLength = strlen(expression);
-    int i = 0, j = 0;
-    /*there are to pointers here, i is for the traversal of the entire expression*/
-    /*j is for the traversal of the storage of the token in tokenList*/
-    tokenListPtr->count = 0;
-    /*initialize the count of all tokens*/
+static unsigned int hashName(char *name, size_t length) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return hash;
+}
 
-    while (i < expressionLength) {
-        if (isspace(expression[i])) {
-        /*if it is space, then skip*/
-            i++;
-            continue;
+static int lookupSymbol(char *name, size_t length, unsigned int hash)
+/*the slot that holds the name, or the empty slot where it would go*/
+{
+    int slot = (int)(hash & (unsigned int)(symbols.slotCount - 1));
+    while (symbols.slots[slot] != 0) {
+        int symbol = symbols.slots[slot] - 1;
+        if (symbols.hashes[symbol] == hash && symbols.lengths[symbol] == length && memcmp(symbols.names[symbol], name, length) == 0) {
+            break;
         }
+        slot = (slot + 1) & (symbols.slotCount - 1);
+    }
+    return slot;
+}
 
-        j = 0;
-        /*j will be initialized for every token*/
-
-        if (isdigit(expression[i])) {
-            while (i < expressionLength && isdigit(expression[i]) && j < TOKEN_MAX_NUM - 1) {
-                tokenListPtr->tokens[tokenListPtr->count][j++] = expression[i++];
-                /*the tokens will be stored in tokenList*/
-                /*note that the while loop here is for the storage of multi-bit numbers*/
-            }
-            tokenListPtr->types[tokenListPtr->count] = TOKEN_IS_NUM;
-            /*if the type is number, then it will be stored*/
+static void growSymbols(void)
+/*double the slots when the table is half full, the ids of the symbols do not change*/
+{
+    int newCount = symbols.slotCount ? symbols.slotCount * 2 : 64;
+    int *newSlots = (int *)arenaCalloc(&exprArena, newCount, sizeof(int));
+    for (int symbol = 0; symbol < symbols.count; symbol++) {
+        int slot = (int)(symbols.hashes[symbol] & (unsigned int)(newCount - 1));
+        while (newSlots[slot] != 0) {
+            slot = (slot + 1) & (newCount - 1);
         }
-        else if (isOperator(expression[i]) || expression[i] == '(' || expression[i] == ')') {
-            /*if the token is an operator or parentheses, it will also need to be stored*/
-            tokenListPtr->tokens[tokenListPtr->count][j++] = expression[i++];
-            tokenListPtr->types[tokenListPtr->count] = TOKEN_IS_OPERATOR;
-            /*store the operator type*/
+        newSlots[slot] = symbol + 1;
+    }
+    symbols.slots = newSlots;
+    symbols.slotCount = newCount;
+}
+
+int internSymbol(char *name, size_t length) {
+    if (2 * (symbols.count + 1) > symbols.slotCount) {
+        growSymbols();
+    }
+    unsigned int hash = hashName(name, length);
+    int slot = lookupSymbol(name, length, hash);
+    if (symbols.slots[slot] != 0) {
+        return symbols.slots[slot] - 1;
+        /*the name has been seen, every later x is just its id*/
+    }
+    if (symbols.count == symbols.capacity) {
+        int newCapacity = symbols.capacity ? symbols.capacity * 2 : VAR_INIT_NUM;
+        char **names = (char **)arenaAlloc(&exprArena, newCapacity * sizeof(char *));
+        size_t *lengths = (size_t *)arenaAlloc(&exprArena, newCapacity * sizeof(size_t));
+        unsigned int *hashes = (unsigned int *)arenaAlloc(&exprArena, newCapacity * sizeof(unsigned int));
+        if (symbols.count > 0) {
+            memcpy(names, symbols.names, symbols.count * sizeof(char *));
+            memcpy(lengths, symbols.lengths, symbols.count * sizeof(size_t));
+            memcpy(hashes, symbols.hashes, symbols.count * sizeof(unsigned int));
         }
-        else if (isalpha(expression[i]) || expression[i] == '_') {
-            /*store the variable type with C standard, which can start with letters of _*/
-            while (i < expressionLength && (isalnum(expression[i]) || expression[i] == '_') && j < TOKEN_MAX_NUM - 1) {
-                /*the isalnum here is for the bits that can be numbers or letters*/
-                tokenListPtr->tokens[tokenListPtr->count][j++] = expression[i++];
-                /*the same as the storage in digit, we also need to consider more bits*/
-            }
-            tokenListPtr->types[tokenListPtr->count] = TOKEN_IS_VAR;
+        symbols.names = names;
+        symbols.lengths = lengths;
+        symbols.hashes = hashes;
+        symbols.capacity = newCapacity;
+    }
+    char *copy = (char *)arenaAlloc(&exprArena, length + 1);
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+    /*the name is copied out of the input once per distinct variable*/
+    symbols.names[symbols.count] = copy;
+    symbols.lengths[symbols.count] = length;
+    symbols.hashes[symbols.count] = hash;
+    symbols.slots[slot] = symbols.count + 1;
+    return symbols.count++;
+}
+
+char *symbolName(int symbol) {
+    return symbols.names[symbol];
+}
+
+size_t symbolLength(int symbol) {
+    return symbols.lengths[symbol];
+}
+
+int symbolCount(void) {
+    return symbols.count;
+}
+
+int nodeStoreSize(void) {
+    return nodeStore.count;
+}
+
+NodeStore *currentNodeStore(void) {
+    return &nodeStore;
+}
+
+int largestId(Node **roots, int count) {
+    int top = -1;
+    for (int k = 0; k < count; k++) {
+        top = roots[k]->id > top ? roots[k]->id : top;
+    }
+    return top;
+}
+
+void markReachable(NodeStore *store, Node **roots, int count, unsigned char *reachable) {
+    for (int k = 0; k < count; k++) {
+        reachable[roots[k]->id] = 1;
+    }
+    for (int id = largestId(roots, count); id >= 0; id--)
+    /*one sweep down the ids for all the roots, a node under several of them is looked at once*/
+    {
+        if (reachable[id] && store->packed[id].left >= 0) {
+            reachable[store->packed[id].left] = 1;
+            /*the children have smaller ids, so they are reached before the loop gets to them*/
         }
-        else {
-            i++;
-            /*the case of other invalid inputs, we can directly skip the characters*/
-            continue;
+        if (reachable[id] && store->packed[id].right >= 0) {
+            reachable[store->packed[id].right] = 1;
         }
+    }
+}
 
-        tokenListPtr->tokens[tokenListPtr->count][j] = '\0';
-        /*store the last token to be NULL string, indicating the termination of the entire sequence*/
-        if (j > 0) {
-        /*j can serve as a flag for actual storage, if 0, then it means that no tokens are stored. */
-            tokenListPtr->count++;
-            /*the count will only be increased when there exists valid token*/
+void releaseExpression(void) {
+    memset(&nodeStore, 0, sizeof(NodeStore));
+    memset(&symbols, 0, sizeof(SymbolTable));
+    arenaReset(&exprArena);
+    /*the store and its nodes all live in the arena, so dropping them is O(1)*/
+    /*every node pointer and string handed out before is invalid from now on*/
+}
+
+bool isOperator(char c) {
+    return (c == '+' || c == '-' || c == '*' || c == '/' || c == '^');
+    /*implement the judgement of operators*/
+}
+
+long readExpression(FILE *file, char **bufferPtr, size_t *capacityPtr) {
+    size_t length = 0;
+    if (*bufferPtr == NULL || *capacityPtr < EXPR_INIT_LEN) {
+        *capacityPtr = EXPR_INIT_LEN;
+        *bufferPtr = (char *)realloc(*bufferPtr, *capacityPtr);
+    }
+    while (fgets(*bufferPtr + length, (int)(*capacityPtr - length), file) != NULL) {
+        length += strlen(*bufferPtr + length);
+        if (length > 0 && (*bufferPtr)[length - 1] == '\n') {
+            return (long)length;
+            /*the whole line is read*/
+        }
+        if (length + 1 < *capacityPtr) {
+            return (long)length;
+            /*the last line of the file, without a newline*/
         }
+        *capacityPtr *= 2;
+        *bufferPtr = (char *)realloc(*bufferPtr, *capacityPtr);
+        /*the line is longer than the buffer, double it and keep reading*/
     }
+    return length > 0 ? (long)length : -1;
 }
-/*tokenize will help us seperate the expression into different parts*/
 
 int getPrecedence(char operator)
 /*help us to get the precedence of different operators*/
@@ -119,52 +321,42 @@ int getPrecedence(char operator)
 
 /*createExpressionTree: Build an expression tree from the token list*/
 /*we will implement with two stacks to store numbers/variables(operands) and operators*/
-Node *createExpressionTree(TokenList *tokenListPtr) {
-    int len = tokenListPtr->count;  /* total number of tokens */
-    /* Stack for operand nodes*/
-    Node *nodeStack[TOKEN_MAX_NUM];
-    int nodeTop = -1;
-    /* Stack for operator nodes*/
-    Node *opStack[TOKEN_MAX_NUM];
+/*the stacks first decide the order of the nodes (postfix), then the nodes are built in that order*/
+int postfixOrder(TokenList *tokenListPtr, int from, int to, int *order, int *opStack) {
+    int count = 0;
+    /*number of entries written to order*/
+    int operands = 0;
+    /*the height the operand stack would have, only the height matters for the error checks*/
     int opTop = -1;
-    /* Process each token in the token list. */
-    for (int i = 0; i < len; i++) {
-        /*if the token is a number, push it in the stack*/
-        if (tokenListPtr->types[i] == TOKEN_IS_NUM) {
-            Node *newNode = createNode(TOKEN_IS_NUM, '\0', atoi(tokenListPtr->tokens[i]), NULL);
-            nodeStack[++nodeTop] = newNode;
-        }
-        /*note that every time we need to create the node*/
-        else if (tokenListPtr->types[i] == TOKEN_IS_VAR) {
-            Node *newNode = createNode(TOKEN_IS_VAR, '\0', 0, tokenListPtr->tokens[i]);
-            nodeStack[++nodeTop] = newNode;
+    /*Stack for operators, holding their token indices*/
+    for (int i = from; i < to; i++) {
+        /*numbers and variables are nodes on their own*/
+        if (tokenListPtr->tokens[i].type == TOKEN_IS_NUM || tokenListPtr->tokens[i].type == TOKEN_IS_VAR) {
+            if (tokenListPtr->tokens[i].value < 0) {
+                return -1;
+                /*a number too large for an int*/
+            }
+            order[count++] = i;
+            operands++;
         }
         /*the case where the token is an operator or a parenthesis*/
-        else if (tokenListPtr->types[i] == TOKEN_IS_OPERATOR) {
-            char currentOp = tokenListPtr->tokens[i][0];
+        else if (tokenListPtr->tokens[i].type == TOKEN_IS_OPERATOR) {
+            char currentOp = tokenListPtr->tokens[i].operator;
             /*tackle the case where left parenthesis appears*/
             if (currentOp == '(') {
-                Node *newNode = createNode(TOKEN_IS_OPERATOR, currentOp, 0, NULL);
-                opStack[++opTop] = newNode;
+                opStack[++opTop] = i;
             }
             /*pop */
             else if (currentOp == ')') {
-                while (opTop >= 0 && opStack[opTop]->operator != '(') {
-                    if (nodeTop < 1)  
+                while (opTop >= 0 && tokenListPtr->tokens[opStack[opTop]].operator != '(') {
+                    if (operands < 2)
                     /* error check for insufficient operands */
                     {
-                        printf("Invalid input\n");
-                        return NULL;
+                        return -1;
                     }
-                    /* Pop an operator node*/
-                    Node *opNode = opStack[opTop--];
-                    /* Pop two operand nodes from nodeStack*/
-                    Node *right = nodeStack[nodeTop--];
-                    Node *left = nodeStack[nodeTop--];
-                    /*set the children nodes and their parents*/
-                    setChildren(opNode, left, right);
-                    /*push the corresponding sub-tree*/
-                    nodeStack[++nodeTop] = opNode;
+                    /* Pop an operator, it takes the two operands on top*/
+                    order[count++] = opStack[opTop--];
+                    operands--;
                 }
                 /*pop the left parenthesis if there is any of them left*/
                 if (opTop >= 0)
@@ -172,101 +364,176 @@ Node *createExpressionTree(TokenList *tokenListPtr) {
             }
             else {
                 /*tackle the case of meeting greater precedence*/
-                while (opTop >= 0 && getPrecedence(opStack[opTop]->operator) >= getPrecedence(currentOp)) {
-                    if (nodeTop < 1)  
+                while (opTop >= 0 && getPrecedence(tokenListPtr->tokens[opStack[opTop]].operator) >= getPrecedence(currentOp)) {
+                    if (operands < 2)
                     /* error check for insufficient operands*/
                     {
-                        printf("Invalid input\n");
-                        return NULL;
+                        return -1;
                     }
-                    Node *opNode = opStack[opTop--];
-                    /*pop two nodes as operands*/
-                    Node *right = nodeStack[nodeTop--];
-                    Node *left = nodeStack[nodeTop--];
-                    /*set the children*/
-                    setChildren(opNode, left, right);
-                    nodeStack[++nodeTop] = opNode;
-                    /*push the node back to the stack*/
+                    order[count++] = opStack[opTop--];
+                    operands--;
                 }
-                Node *newOpNode = createNode(TOKEN_IS_OPERATOR, currentOp, 0, NULL);
-                opStack[++opTop] = newOpNode;
+                opStack[++opTop] = i;
             }
         }
     }
     /*processing left parenthesis that are left here*/
     while (opTop >= 0) {
-        if (nodeTop < 1)
+        if (operands < 2)
         /*error check*/
         {
-            printf("Invalid input\n");
-            return NULL;
+            return -1;
         }
-        Node *opNode = opStack[opTop--];
-        Node *right = nodeStack[nodeTop--];
-        Node *left = nodeStack[nodeTop--];
-        setChildren(opNode, left, right);
-        /*set the corresponding children*/
-        nodeStack[++nodeTop] = opNode;
-    }
-    if (nodeTop != 0)  /* If there is more than one node, then the input is invalid */
+        order[count++] = opStack[opTop--];
+        operands--;
+    }
+    if (operands != 1)  /* If there is more than one node, then the input is invalid */
     {
-        printf("Invalid input\n");
-        return NULL;
+        return -1;
+    }
+    return count;
+}
+
+Node *nodeFromPostfix(TokenList *tokenListPtr, int *order, int count) {
+    /* Stack for operand nodes, there can never be more entries than tokens*/
+    Node **nodeStack = (Node **)arenaAlloc(&exprArena, (count + 1) * sizeof(Node *));
+    int nodeTop = -1;
+    for (int i = 0; i < count; i++) {
+        Token *token = &tokenListPtr->tokens[order[i]];
+        /*if the token is a number, push it in the stack*/
+        if (token->type == TOKEN_IS_NUM) {
+            nodeStack[++nodeTop] = createNode(TOKEN_IS_NUM, '\0', token->value, -1);
+        }
+        /*note that every time we need to create the node*/
+        else if (token->type == TOKEN_IS_VAR) {
+            nodeStack[++nodeTop] = createNode(TOKEN_IS_VAR, '\0', 0, internSymbol(TOKEN_TEXT(tokenListPtr, order[i]), token->length));
+            /*the name is hashed once here, from then on the variable is only its symbol id*/
+        }
+        else {
+            /* Pop two operand nodes from nodeStack, postfixOrder() made sure that they are there*/
+            Node *right = nodeStack[nodeTop--];
+            Node *left = nodeStack[nodeTop--];
+            /*build (or share) the operator node with its children*/
+            nodeStack[++nodeTop] = internNode(TOKEN_IS_OPERATOR, token->operator, 0, -1, left, right);
+            /*push the corresponding sub-tree*/
+        }
     }
     /*return the final node, which is the root.*/
     return nodeStack[nodeTop];
 }
 
+Node *createExpressionTree(TokenList *tokenListPtr) {
+    int len = tokenListPtr->count;  /* total number of tokens */
+    int *order = (int *)arenaAlloc(&exprArena, (len + 1) * sizeof(int));
+    int *opStack = (int *)arenaAlloc(&exprArena, (len + 1) * sizeof(int));
+    int count = postfixOrder(tokenListPtr, 0, len, order, opStack);
+    if (count < 0) {
+        return NULL;
+    }
+    return nodeFromPostfix(tokenListPtr, order, count);
+}
+
+Node *parseExpression(char *expression, size_t length, TokenList *tokenListPtr) {
+    if (gradPool != NULL && length >= PARSE_PARALLEL_MIN) {
+        return parseParallel(gradPool, expression, length, tokenListPtr);
+        /*a huge expression is tokenized and ordered in chunks on the pool*/
+    }
+    tokenizeRange(expression, length, tokenListPtr);
+    return createExpressionTree(tokenListPtr);
+}
+
 void setChildren(Node *parent, Node *left, Node *right)
-/*the function to set the children of a node and the parent of the node, to make indexing easier.*/
+/*the function to set the children of a node, it is only used while the node is built*/
 {
     parent->Left = left;
     parent->Right = right;
     /*setting the children of the parent node*/
-    left->Parent = parent;
-    right->Parent = parent;
-    /*setting the parent node of the currentnode*/
+    /*nodes are shared and never changed afterwards, so no cached expression can go out of date*/
 }
 
-char* getNodeExpr(Node* node)
+static Rope* renderNode(Node* node);
+
+Rope* getNodeExpr(Node* node)
 {
     /*used to visit the expression of the current node*/
+    if (node->expr != NULL)
+    {
+        return node->expr;
+        /*render only on the first use, every later call (for any variable) gets the same rope*/
+    }
+    int capacity = 64, top = 0;
+    Node** stack = (Node**)malloc(capacity * sizeof(Node*));
+    stack[top++] = node;
+    /*the nodes waiting for their operands to be rendered, on the heap so any depth fits*/
+    /*the node pointers are used rather than the packed ids, a task may render on a thread with a store of its own*/
+    while (top > 0)
+    {
+        Node* current = stack[top - 1];
+        if (current->expr != NULL)
+        {
+            top--;
+            continue;
+        }
+        bool leftMissing = current->Left != NULL && current->Left->expr == NULL;
+        bool rightMissing = current->Right != NULL && current->Right->expr == NULL;
+        if (leftMissing || rightMissing)
+        {
+            if (top + 2 > capacity)
+            {
+                capacity *= 2;
+                stack = (Node**)realloc(stack, capacity * sizeof(Node*));
+            }
+            if (rightMissing)
+            {
+                stack[top++] = current->Right;
+            }
+            if (leftMissing)
+            {
+                stack[top++] = current->Left;
+            }
+            continue;
+            /*come back to the node once both operands are rendered*/
+        }
+        current->expr = renderNode(current);
+        top--;
+    }
+    free(stack);
+    return node->expr;
+}
+
+static Rope* renderNode(Node* node)
+{
     if (node->type == TOKEN_IS_VAR)
     {
         /*variable case*/
-        return strdup(node->variable);
-        /*strdup is used to return a string that is copied, but not a pointer to the same memory space*/
+        return ropeText(symbolName(node->symbol), symbolLength(node->symbol));
+        /*the rope points at the interned name, nothing is copied*/
     }
     else if (node->type == TOKEN_IS_NUM)
     {
         /*number case*/
-        char buf[EXPR_MAX_LEN];
-        /*initialize a buffer zone*/
-        sprintf(buf, "%d", node->number);
-        /*we use sprintf to store the string into the buffer zone*/
-        /*copy the number to the buffer zone*/
+        char* text = formatExpr("%d", node->number);
         /*note that the number here is stored in the string form*/
-        return strdup(buf);
+        return ropeText(text, strlen(text));
     }
     else if (node->type == TOKEN_IS_OPERATOR)
     {
         /*the case where the token is an operator*/
-        char* left = getNodeExpr(node->Left);
+        Rope* left = node->Left->expr;
         /*extract the number as the left operand*/
-        char* right = getNodeExpr(node->Right);
-        /*extract the number as the right operand*/
+        Rope* right = node->Right->expr;
+        /*extract the number as the right operand, getNodeExpr() rendered both of them first*/
         char op = node->operator;
         /*extract the operator*/
-        char buf[EXPR_MAX_LEN];
-        /*create the buffer zone for storing*/
-        sprintf(buf, "(%s %c %s)", left, op, right);
-        /*push the expression into the buffer*/
-        free(left);
-        free(right);
-        /*free the memory space that are malloced*/
-        return strdup(buf);
-    }
-    return strdup("0");
+        return ropeBuild("(%r %c %r)", left, op, right);
+        /*concatenate the pieces without copying the text of the operands*/
+    }
+    else if (node->type == TOKEN_IS_FUNCTION)
+    {
+        return node->operator == 'l' ? ropeBuild("ln(%r)", node->Left->expr) : ropeBuild("(-%r)", node->Left->expr);
+        /*only derivatives have functions, the input never does*/
+    }
+    return &ropeZero;
     /*if no situation is satisfied, then return 0 directly*/
 }
 
@@ -278,12 +545,17 @@ char* formatExpr(char* fmt, ...)
     /*variable arguments, change depend on the situation*/
     va_start(args, fmt);
     /*fmt is the last fixed parameter*/
-    int len = vsnprintf(NULL, 0, fmt, args);
-    /*although we don't need the buffer, we can use this function to get the length of the string*/
+    char probe[FORMAT_PROBE_LEN];
+    int len = vsnprintf(probe, sizeof(probe), fmt, args);
+    /*a short string is done here, a longer one is cut off but we still get its length*/
     va_end(args);
     /*clean up the argument list*/
-    char* buf = (char*)malloc(len + 1);
-    /*malloc the buffer space for the expression*/
+    char* buf = (char*)arenaAlloc(&exprArena, len + 1);
+    /*take the buffer space for the expression from the arena*/
+    if (len < (int)sizeof(probe)) {
+        memcpy(buf, probe, len + 1);
+        return buf;
+    }
     va_start(args, fmt);
     vsnprintf(buf, len + 1, fmt, args);
     /*store the string into the buffer zone*/
@@ -292,285 +564,406 @@ char* formatExpr(char* fmt, ...)
     return buf;
 }
 
-void collectVariables(Node* node, char** vars, int* count)
+void collectVariables(Node** roots, int count, VarList* list)
 {
 /*used to determine whether the given variable exists in our expression*/
-    if (!node)
+    if (list->seen == NULL)
     {
-        return;
+        int count = symbolCount();
+        list->seen = (unsigned char*)arenaCalloc(&exprArena, count / 8 + 1, 1);
+        list->symbols = (int*)arenaAlloc(&exprArena, (count + 1) * sizeof(int));
+        /*a variable is a symbol of the expression, so there can be no more of them than symbols*/
     }
-    /*the case where the node is NULL*/
-    if (node->type == TOKEN_IS_VAR)
+    int top = largestId(roots, count);
+    unsigned char* reachable = (unsigned char*)arenaCalloc(&exprArena, top + 1, 1);
+    markReachable(&nodeStore, roots, count, reachable);
+    /*one sweep over the packed nodes finds the subtrees, a shared subtree is looked at once*/
+    for (int id = 0; id <= top; id++)
+    /*in the order of the ids, which is the order the variables were met in the input*/
     {
-        bool exists = false;
-        /*initially set to false*/
-        for (int i = 0; i < *count; i++)
-        /*traverse through all the variables*/
+        PackedNode* packed = &nodeStore.packed[id];
+        if (!reachable[id] || PACKED_TYPE(packed->tag) != TOKEN_IS_VAR)
         {
-            if (strcmp(vars[i], node->variable) == 0)
-            /*indicates that the variable exists*/
-            {
-                exists = true;
-                /*flag set to true*/
-                break;
-            }
+            continue;
         }
-        if (!exists && *count < TOKEN_MAX_NUM)
-        /*there doesn't exist the variable*/
+        int symbol = packed->operand.symbol;
+        if (!(list->seen[symbol / 8] & (1 << (symbol % 8))))
+        /*there doesn't exist the variable, one bit test instead of comparing with every name*/
         {
-            vars[*count] = strdup(node->variable);
-            /*copy the variable that has never been seen*/
-            (*count)++;
+            list->seen[symbol / 8] |= (unsigned char)(1 << (symbol % 8));
+            list->symbols[list->count] = symbol;
+            list->count++;
             /*count increment*/
-            /*note that count is a pointer because we want to modify the value of it*/
         }
     }
-    collectVariables(node->Left, vars, count);
-    /*tail recursion to implement the collection in left subtree*/
-    collectVariables(node->Right, vars, count);
-    /*collect in the right subtree*/
 }
 
-/*calculate the derivatives*/
-char* derive(Node* node, char* var)
+static bool isNumber(Node* node, int number)
 {
-    if (node->type == TOKEN_IS_VAR)
+    return node->type == TOKEN_IS_NUM && node->number == number;
+}
+
+static Node* numberNode(int number)
+{
+    return createNode(TOKEN_IS_NUM, '\0', number, -1);
+}
+
+static Node* functionNode(char function, Node* operand)
+/*ln(a) for 'l' and -a for '-'*/
+{
+    if (function == '-' && isNumber(operand, 0))
+    {
+        return operand;
+        /*the negation of zero is still zero*/
+    }
+    return internNode(TOKEN_IS_FUNCTION, function, 0, -1, operand, NULL);
+}
+
+static Node* operatorNode(char op, Node* a, Node* b)
+/*build a op b with the operands that are 0 or 1 simplified away, the same rules the derivative text always had*/
+{
+    switch (op) {
+        case '+':
+            if (isNumber(a, 0))
+                return b;
+            if (isNumber(b, 0))
+                return a;
+            break;
+        case '-':
+            if (isNumber(b, 0))
+                return a;
+            if (isNumber(a, 0))
+                return functionNode('-', b);
+            break;
+        case '*':
+            if (isNumber(a, 0) || isNumber(b, 0))
+                return numberNode(0);
+            /*anything multiplied by zero is zero*/
+            if (isNumber(a, 1))
+                return b;
+            if (isNumber(b, 1))
+                return a;
+            break;
+        case '/':
+            if (isNumber(a, 0))
+                return a;
+            /*zero divided by anything (that is valid) is zero*/
+            if (isNumber(b, 1))
+                return a;
+            break;
+    }
+    return internNode(TOKEN_IS_OPERATOR, op, 0, -1, a, b);
+    /*the node goes through the store, so equal pieces of different derivatives are one node*/
+}
+
+void recordTape(Node** roots, int count, GradTape* tape, int* indices)
+/*the forward sweep, children are recorded before their parent so that the tape is in topological order*/
+{
+    int top = largestId(roots, count);
+    if (top >= tape->indexCapacity)
     {
-        if (strcmp(node->variable, var) == 0)
+        int newCapacity = nodeStoreSize();
+        tape->indexOf = (int*)realloc(tape->indexOf, newCapacity * sizeof(int));
+        for (int i = tape->indexCapacity; i < newCapacity; i++)
         {
-            return strdup("1");
-            /*if the variable is equal to the current node, then the variable is one*/
-            /*note that the numbers are always stored in string*/
+            tape->indexOf[i] = -1;
         }
-        else
+        tape->indexCapacity = newCapacity;
+    }
+    unsigned char* reachable = (unsigned char*)arenaCalloc(&exprArena, top + 1, 1);
+    markReachable(&nodeStore, roots, count, reachable);
+    /*all the roots are marked in one sweep, so k roots cost one pass over the ids and not k*/
+    for (int id = 0; id <= top; id++)
+    /*the nodes are built in postfix order, so going up the ids records them in the order of a depth-first walk*/
+    {
+        if (!reachable[id] || tape->indexOf[id] >= 0)
         {
-            /*if the variable is not equal to the current node, then the derivate must be independent*/
-            return strdup("0");
+            continue;
+            /*a shared subexpression is recorded only once, its adjoint collects every use*/
         }
+        PackedNode* packed = &nodeStore.packed[id];
+        if (tape->count == tape->capacity)
+        {
+            tape->capacity = tape->capacity ? tape->capacity * 2 : 16;
+            tape->entries = (TapeEntry*)realloc(tape->entries, tape->capacity * sizeof(TapeEntry));
+            /*double the space of the tape when it is full*/
+        }
+        TapeEntry* entry = &tape->entries[tape->count];
+        entry->node = nodeStore.nodes[id];
+        entry->left = packed->left >= 0 ? tape->indexOf[packed->left] : -1;
+        entry->right = packed->right >= 0 ? tape->indexOf[packed->right] : -1;
+        /*the operands have smaller ids, so they are on the tape already*/
+        entry->adjoint = NULL;
+        tape->indexOf[id] = tape->count++;
     }
-    else if (node->type == TOKEN_IS_NUM)
+    for (int k = 0; k < count && indices != NULL; k++)
     {
-        /*the derivative of a constant is undoubtedly 0*/
-        return strdup("0");
+        indices[k] = tape->indexOf[roots[k]->id];
     }
-    else if (node->type == TOKEN_IS_OPERATOR)
+}
+
+static void accumulateAdjoint(TapeEntry* entry, Node* contribution)
+/*add the contribution into the adjoint of the entry*/
+{
+    if (entry->adjoint == NULL)
     {
-        /*tackle the problem of derivative with operators*/
-        char op = node->operator;
-        /*get the operator*/
-        char* leftDeriv = derive(node->Left, var);
-        /*get the derivative of the left operand*/
-        char* rightDeriv = derive(node->Right, var);
-        /*get the derivative of the right operand*/
-        char* leftExpr = getNodeExpr(node->Left);
-        /*get the expression of the left operand*/
-        char* rightExpr = getNodeExpr(node->Right);
-        /*get the expression of the right operand*/
-        /*these four expression will be used in the deriving process*/
-        char* result = NULL;
-        /*default output*/
-        switch(op) {
-            /*switch the case according to the operator*/
+        entry->adjoint = contribution;
+        /*the first path from the root to this node*/
+        return;
+    }
+    entry->adjoint = operatorNode('+', contribution, entry->adjoint);
+}
+
+void backward(GradTape* tape, int* vars, int varCount, Node** partials)
+{
+    int* position = (int*)arenaAlloc(&exprArena, (symbolCount() + 1) * sizeof(int));
+    for (int i = 0; i < symbolCount(); i++)
+    {
+        position[i] = -1;
+    }
+    for (int i = 0; i < varCount; i++)
+    {
+        partials[i] = numberNode(0);
+        /*every variable starts with no contribution*/
+        position[vars[i]] = i;
+        /*where the derivative of every symbol goes, -1 for the symbols that are not asked for*/
+    }
+    if (tape->count == 0)
+    {
+        return;
+    }
+    tape->entries[tape->count - 1].adjoint = numberNode(1);
+    /*the derivative of the root with respect to itself is one*/
+    PolynomialSet* polys = beginPolynomials();
+    Node** gradient = (Node**)arenaAlloc(&exprArena, (varCount + 1) * sizeof(Node*));
+    int* slots = (int*)arenaAlloc(&exprArena, (varCount + 1) * sizeof(int));
+
+    for (int i = tape->count - 1; i >= 0; i--)
+    /*walk the tape backwards, so every node is finished before its children are visited*/
+    {
+        TapeEntry* entry = &tape->entries[i];
+        Node* node = entry->node;
+        Node* adjoint = entry->adjoint;
+        if (adjoint == NULL)
+        {
+            continue;
+        }
+        if (node->type == TOKEN_IS_VAR)
+        {
+            if (position[node->symbol] >= 0)
+            /*the slot of the variable is looked up by its symbol id*/
+            {
+                Node** slot = &partials[position[node->symbol]];
+                *slot = operatorNode('+', adjoint, *slot);
+                /*the leaves are visited from right to left, so the new term goes in front*/
+            }
+            continue;
+        }
+        int found = polynomialGradient(polys, node, position, gradient, slots);
+        if (found >= 0)
+        /*a polynomial part is differentiated by shifting the exponents of its monomials, nothing below it needs an adjoint*/
+        {
+            for (int k = 0; k < found; k++)
+            {
+                Node** slot = &partials[slots[k]];
+                *slot = operatorNode('+', operatorNode('*', adjoint, gradient[slots[k]]), *slot);
+            }
+            continue;
+        }
+        if (node->type == TOKEN_IS_FUNCTION)
+        {
+            TapeEntry* operand = &tape->entries[entry->left];
+            if (nodeStore.depends[operand->node->id] != 0)
+            {
+                accumulateAdjoint(operand, node->operator == 'l' ? operatorNode('/', adjoint, operand->node) : functionNode('-', adjoint));
+                /*a derivative can be differentiated again, it is the only tree with functions*/
+            }
+            continue;
+        }
+        if (node->type != TOKEN_IS_OPERATOR)
+        {
+            continue;
+            /*constants pass nothing further*/
+        }
+        TapeEntry* left = &tape->entries[entry->left];
+        TapeEntry* right = &tape->entries[entry->right];
+        bool needLeft = nodeStore.depends[left->node->id] != 0;
+        bool needRight = nodeStore.depends[right->node->id] != 0;
+        /*the adjoint of a subtree without variables is never used, so it is not built at all*/
+        switch (node->operator) {
             case '+':
-                if (strcmp(leftDeriv, "0") == 0 && strcmp(rightDeriv, "0") == 0)
-                {
-                    result = strdup("0");
-                    /*if the left and right derivative are all zero, then the output must be also zero.*/
-                }
-                else if (strcmp(leftDeriv, "0") == 0)
-                {
-                    /*simplifying the answer*/
-                    result = strdup(rightDeriv);
-                }
-                else if (strcmp(rightDeriv, "0") == 0)
-                {
-                    /*simplifying the answer in the same way*/
-                    result = strdup(leftDeriv);
-                }
-                else
-                {
-                    /*in this case, there's no space for further simplification*/
-                    result = formatExpr("(%s + %s)", leftDeriv, rightDeriv);
-                }
+                if (needLeft) accumulateAdjoint(left, adjoint);
+                if (needRight) accumulateAdjoint(right, adjoint);
                 break;
             case '-':
-            /*the situation of minus*/
-                if (strcmp(leftDeriv, "0") == 0 && strcmp(rightDeriv, "0") == 0)
-                {
-                    result = strdup("0");
-                    /*if the left and right are both 0, then output 0 directly*/
-                }
-                else if (strcmp(leftDeriv, "0") == 0)
-                {
-                    /*if the left is 0, then output the negation of the right derivative*/
-                    result = formatExpr("(-%s)", rightDeriv);
-                    /*single variable format expression is also feasible because of our function*/
-                }
-                else if (strcmp(rightDeriv, "0") == 0)
-                {
-                    /*if the right derivative is 0, then directly output the leftderivative*/
-                    result = strdup(leftDeriv);
-                }
-                else
-                {
-                    /*no space for simplification*/
-                    result = formatExpr("(%s - %s)", leftDeriv, rightDeriv);
-                    break;
-                }
+                if (needLeft) accumulateAdjoint(left, adjoint);
+                if (needRight) accumulateAdjoint(right, functionNode('-', adjoint));
+                break;
             case '*':
-            /*here we tackle the case of multiplication*/
-                if (strcmp(leftExpr, "0") == 0 && strcmp(rightExpr, "0") == 0)
-                /*if all zero, then directly output 0*/
-                {
-                    result = strdup("0");
-                    /*directly output 0*/
-                }
-                else if (strcmp(leftExpr, "0") == 0)
-                /*only one side of the expression is zero*/
-                {
-                    if (strcmp(rightDeriv, "0") == 0)
-                    {
-                        /*if the right derivative is zero*/
-                        result = strdup("0");
-                        /*output 0*/
-                    }
-                    else
-                    {
-                        if (strcmp(leftExpr, "1") == 0)
-                        {
-                            /*if the left expression is 1*/
-                            result = strdup(rightDeriv);
-                            /*output the right derivative*/
-                        }
-                        else if (strcmp(rightDeriv, "1") == 0)
-                        {
-                            /*if the right derivative is 1*/
-                            result = strdup(leftExpr);
-                            /*output the left expression*/
-                        }
-                        else
-                        {
-                            result = formatExpr("(%s * %s)", leftExpr, rightDeriv);
-                            /*output the answer of the multiplication*/
-                        }
-                    }
-                }
-                else if (strcmp(rightExpr, "0") == 0)
-                {
-                    /*if the right expression is 0*/
-                    if (strcmp(leftDeriv, "0") == 0)
-                    {
-                        /*if the right expression and left derivative are all zero*/
-                        result = strdup("0");
-                        /*output 0*/
-                    }
-                    else
-                    {
-                        /*if the left derivative is not zero*/
-                        result = formatExpr("(%s * %s)", rightExpr, leftDeriv);
-                        /*output the answer of the multiplication*/
-                    }
-                }
-                else if (strcmp(leftDeriv, "0") == 0 && strcmp(rightDeriv, "0") == 0)
-                {
-                    /*if the left and right derivative are all zero*/
-                    result = strdup("0");
-                    /*output 0*/
-                }
-                else if (strcmp(leftDeriv, "0") == 0)
-                {
-                    /*if the left derivative is zero*/
-                    result = formatExpr("(%s * %s)", leftExpr, rightDeriv);
-                    /*output the answer of the multiplication*/
-                }
-                else if (strcmp(rightDeriv, "0") == 0)
-                {
-                    /*if the right derivative is zero*/
-                    result = formatExpr("(%s * %s)", rightExpr, leftDeriv);
-                    /*output the answer of the multiplication*/
-                }
-                else
-                {
-                    /*if there's no space for simplification*/
-                    result = formatExpr("(%s * %s + %s * %s)", leftExpr, rightDeriv, rightExpr, leftDeriv);
-                    /*output the answer of the multiplication*/
-                }
+                if (needLeft) accumulateAdjoint(left, operatorNode('*', adjoint, right->node));
+                if (needRight) accumulateAdjoint(right, operatorNode('*', adjoint, left->node));
+                /*each operand receives the adjoint times the other operand*/
                 break;
             case '/':
-                result = formatExpr("((%s * %s - %s * %s) / (%s ^ 2))", leftDeriv, rightExpr, rightDeriv, leftExpr, rightExpr);
-                /*output the answer of the division by the division derivative law*/
+                if (needLeft) accumulateAdjoint(left, operatorNode('/', adjoint, right->node));
+                if (needRight)
+                {
+                    /*d(a / b) / db = -a / b ^ 2*/
+                    Node* numerator = operatorNode('*', adjoint, left->node);
+                    Node* square = operatorNode('^', right->node, numberNode(2));
+                    Node* quotient = operatorNode('/', numerator, square);
+                    accumulateAdjoint(right, functionNode('-', quotient));
+                }
                 break;
             case '^':
+                if (needLeft)
                 {
-                    char *powExpr = getNodeExpr(node);
-                    /*get the power of the expression*/
-                    char *term1 = formatExpr("%s * ln(%s)", rightDeriv, leftExpr);
-                    /*separate the expression into two parts*/
-                    char* term2 = formatExpr("%s * %s / %s", rightExpr, leftDeriv, leftExpr);
-                    char *sumTerms = formatExpr("(%s + %s)", term1, term2);
-                    /*get the sumterms*/
-                    result = formatExpr("%s * %s", powExpr, sumTerms);
-                    free(term1);
-                    /*free the memory space*/
-                    free(term2);
-                    free(sumTerms);
-                    free(powExpr);
+                    /*d(a ^ b) / da = a ^ b * b / a*/
+                    Node* scaled = operatorNode('*', node, right->node);
+                    Node* quotient = operatorNode('/', scaled, left->node);
+                    accumulateAdjoint(left, operatorNode('*', adjoint, quotient));
+                }
+                if (needRight)
+                {
+                    /*d(a ^ b) / db = a ^ b * ln(a)*/
+                    Node* logNode = functionNode('l', left->node);
+                    Node* product = operatorNode('*', node, logNode);
+                    accumulateAdjoint(right, operatorNode('*', adjoint, product));
                 }
                 break;
-            default:
-                result = strdup("0");
-                /*default output*/
         }
-        free(leftDeriv);
-        free(rightDeriv);
-        free(leftExpr);
-        free(rightExpr);
-        /*free all the memory that is malloced*/
-        return result;
     }
-    return strdup("0");
+}
+
+void freeTape(GradTape* tape)
+{
+    free(tape->entries);
+    free(tape->indexOf);
+    tape->entries = NULL;
+    tape->indexOf = NULL;
+    tape->count = tape->capacity = tape->indexCapacity = 0;
+}
+
+void setGradPool(ThreadPool *pool) {
+    gradPool = pool;
+}
+
+void setGradOptimizer(const OptimizeBudget *budget) {
+    gradOptimizer = budget;
+}
+
+typedef struct PartialJob {
+    char *name;
+    /*the name of the variable, looked up by the owner because the symbol table is not shared*/
+    size_t nameLength;
+    /*its length*/
+    Rope *partial;
+    /*its derivative*/
+    OutputBuffer text;
+    /*the line "variable: derivative" written by the task*/
+} PartialJob;
+/*the work of one variable, the tasks only read the ropes and write into their own buffers*/
+
+static void writePartial(void *arg) {
+    PartialJob *job = (PartialJob *)arg;
+    outputText(&job->text, job->name, job->nameLength);
+    outputText(&job->text, ": ", 2);
+    outputRope(&job->text, job->partial);
+    outputText(&job->text, "\n", 1);
+}
+
+static void writePartialsParallel(int *variables, Rope **partials, int varCount, OutputBuffer *out) {
+    PartialJob *jobs = (PartialJob *)calloc(varCount, sizeof(PartialJob));
+    TaskGroup group = {0};
+    for (int i = 0; i < varCount; i++) {
+        jobs[i].name = symbolName(variables[i]);
+        jobs[i].nameLength = symbolLength(variables[i]);
+        jobs[i].partial = partials[i];
+        poolSubmit(gradPool, &group, writePartial, &jobs[i]);
+    }
+    poolWait(gradPool, &group);
+    for (int i = 0; i < varCount; i++) {
+        outputText(out, jobs[i].text.data, jobs[i].text.length);
+        free(jobs[i].text.data);
+        /*collected in the sorted order, whichever task finished first*/
+    }
+    free(jobs);
 }
 
 void calculateGrad(Node *root) {
+    OutputBuffer out = {NULL, 0, 0};
+    calculateGradTo(root, &out);
+    fwrite(out.data, 1, out.length, stdout);
+    /*write the whole gradient to the terminal*/
+    free(out.data);
+}
+
+void calculateGradTo(Node *root, OutputBuffer *out) {
     if (!root) {
-        printf("Invalid input!\n");
+        outputFormat(out, "Invalid input!\n");
         return;
     /*if the expression tree is not generated, then return NULL*/
     }
 
-    char* variables[TOKEN_MAX_NUM];
+    VarList list = {NULL, 0, NULL};
     /*create the variable list*/
-    int varCount = 0;
+    collectVariables(&root, 1, &list);
+    int* variables = list.symbols;
+    int varCount = list.count;
     /*count the number of variables*/
-    collectVariables(root, variables, &varCount);
     /*collect variables recursively from the root pointer of the entire expression tree*/
     if (varCount == 0) {
-        printf("Underivable Expression!\n");
+        outputFormat(out, "Underivable Expression!\n");
         /*if there is no variable, then the expression is underivable*/
         return;
     }
 
-    qsort(variables, varCount, sizeof(char*), compareStrings);
-    /*sort the variables in the lexicographical order, with compareStrings() providing the comparing function*/
+    qsort(variables, varCount, sizeof(int), compareSymbols);
+    /*sort the variables in the lexicographical order, with compareSymbols() providing the comparing function*/
+    /*the names are compared only here, once per expression*/
     /*because the requirement is to output with the lexicographical order, I use this.*/
 
+    GradTape tape = {NULL, 0, 0, NULL, 0};
+    recordTape(&root, 1, &tape, NULL);
+    /*one forward sweep over the tree*/
+    Node** partialNodes = (Node**)arenaAlloc(&exprArena, varCount * sizeof(Node*));
+    backward(&tape, variables, varCount, partialNodes);
+    /*one adjoint sweep gives the derivatives of all the variables, instead of one pass per variable*/
+    simplifyAll(partialNodes, varCount);
+    /*simplified together, so the pieces the derivatives share are simplified once*/
+    if (gradOptimizer != NULL) {
+        optimizeAll(partialNodes, varCount, gradOptimizer);
+        /*the simplified derivatives are a much smaller start for the e-graph*/
+    }
+    Rope** partials = (Rope**)arenaAlloc(&exprArena, varCount * sizeof(Rope*));
     for (int i = 0; i < varCount; i++) {
-        char* derivExpr = derive(root, variables[i]);
-        /*calculate the derivative of the expression*/
-        /*traversing through every variable from the root*/
-        printf("%s: %s\n", variables[i], derivExpr);
-        /*output the variable and their derivatives*/
-        free(derivExpr);
-        /*setting free memory space*/
+        partials[i] = getNodeExpr(partialNodes[i]);
+        /*rendered on this thread, the renderings of shared pieces are cached on their nodes*/
     }
 
+    size_t totalLength = 0;
     for (int i = 0; i < varCount; i++) {
-        free(variables[i]);
-        /*setting free the memory space*/
+        totalLength += partials[i]->length;
+        /*the length of a rope is known without looking at its text*/
+    }
+    if (gradPool != NULL && varCount > 1 && totalLength >= GRAD_PARALLEL_MIN) {
+        writePartialsParallel(variables, partials, varCount, out);
+        /*a big gradient: every variable is written out by its own task*/
+    }
+    else {
+        for (int i = 0; i < varCount; i++) {
+            outputText(out, symbolName(variables[i]), symbolLength(variables[i]));
+            outputText(out, ": ", 2);
+            outputRope(out, partials[i]);
+            outputText(out, "\n", 1);
+            /*output the variable and their derivatives, the rope is only turned into text here*/
+        }
     }
+    freeTape(&tape);
+    /*the variables and the derivatives belong to the expression arena, released with the expression*/
 }
 
-int compareStrings(char *a, char *b) {
-    return strcmp(* (char **)a, * (char **)b);
+int compareSymbols(const void *a, const void *b) {
+    return strcmp(symbolName(*(const int *)a), symbolName(*(const int *)b));
     /*compare the strings in the lexicographical order, which is going to be used in the qsort()*/
 }
\ No newline at end of file
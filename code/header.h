@@ -2,17 +2,76 @@
 #define HEADER
 /*include guard, ensuring the overall safety*/
 
-#define EXPR_MAX_LEN 50
-/*maximum length for the input expression*/
-#define VAR_MAX_LEN 10
-/*maximum length for the variable name*/
-#define TOKEN_MAX_NUM 20
-/*maximum number for tokens*/
+#define EXPR_INIT_LEN 64
+/*initial length of the input buffer, it grows with the input*/
+#define TOKEN_INIT_NUM 64
+/*initial number of token slots, the token list grows when it is full*/
+#define FORMAT_PROBE_LEN 64
+/*room on the stack for formatExpr() and outputFormat(), a longer string is formatted a second time*/
+#define VAR_INIT_NUM 16
+/*initial number of variable slots*/
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+/*default size of one block of the arena*/
+
+#define GRAD_PARALLEL_MIN (64 * 1024)
+/*total length of the derivatives from which they are written out by parallel tasks*/
+#define PARSE_PARALLEL_MIN (1024 * 1024)
+/*length of an expression from which parseExpression() tokenizes and orders it in chunks on the pool*/
+#define SIMPLIFY_MAX_PASSES 16
+/*the simplifier stops after this many passes over the derivatives even if the last one still changed something*/
+#define OPTIMIZE_NODE_BUDGET 20000
+/*default number of e-graph nodes the optimizer may build for the gradient of one expression*/
+#define OPTIMIZE_ROUND_BUDGET 16
+/*default rounds of rewriting the optimizer may run on the gradient of one expression, saturation rarely takes more than 12*/
+#define POLY_MAX_TERMS 4096
+/*the most terms a polynomial may expand to before its tree is differentiated the general way*/
+#define COLUMN_BLOCK_BYTES (256 * 1024)
+/*the registers of one block of rows of the column evaluator are kept about this big, so they stay in the cache*/
+#define COLUMN_MIN_ROWS 16
+#define COLUMN_MAX_ROWS 1024
+/*the bounds of the rows of one block, every block is a multiple of COLUMN_MIN_ROWS, the widest vector*/
+#define DATASET_CHUNK_ROWS (256 * 1024)
+/*rows of a dataset that are read at a time, two chunks are in memory, one being read and one being evaluated*/
+#define DATASET_SLICE_ROWS (8 * 1024)
+/*rows of one task of the pool, the chunk is a whole number of them and the sums are reduced slice by slice*/
+#define BATCH_SEPARATOR "---"
+/*the line printed after the gradient of every expression in batch mode*/
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+/*every thread gets its own copy of a variable declared with this*/
 
 #define TOKEN_IS_NUM 'N'
 #define TOKEN_IS_VAR 'V'
 #define TOKEN_IS_OPERATOR 'O'
 /*define some representative values*/
+#define TOKEN_IS_FUNCTION 'F'
+/*a node that applies ln ('l') or negation ('-') to its Left child, only derivatives are built with it*/
+
+typedef struct ArenaBlock {
+    struct ArenaBlock * next;
+    /*next block of the same arena*/
+    size_t size;
+    /*usable bytes of data*/
+    size_t used;
+    /*bytes handed out so far*/
+    char data[];
+    /*the memory itself*/
+} ArenaBlock;
+
+typedef struct Arena {
+    ArenaBlock * first;
+    /*the first block, the arena is rewound to it by arenaReset()*/
+    ArenaBlock * current;
+    /*the block that allocations are taken from*/
+    size_t blockSize;
+    /*size of a new block, 0 means ARENA_BLOCK_SIZE*/
+} Arena;
+/*bump allocator, everything in it is released together instead of one free() per object*/
 
 typedef struct Node {
     int type;   
@@ -21,47 +80,400 @@ typedef struct Node {
     /*operator if the type is N +, -, *, /, ^*/
     int number;
     /*literal num if the type is N*/
-    char variable[VAR_MAX_LEN];
-    /*name of the variable if the type is V*/
+    int symbol;
+    /*symbol id of the variable if the type is V, -1 otherwise*/
     struct Node * Left, * Right;
-    /*Left and Right child tree*/
-    struct Node * Parent;
-    /*parent node*/
+    /*Left and Right child tree, Right is NULL for a function, a node never changes after it is built so it needs no parent*/
+    int id;
+    /*index of the node in the node store, identical subexpressions have the same id*/
+    struct Node * next;
+    /*next node in the same bucket of the node store*/
+    struct Rope * expr;
+    /*the rendered expression of the node, NULL until getNodeExpr() is first called on it*/
+    int size;
+    /*number of nodes under it counted as a tree, shared nodes once per use, at most INT_MAX*/
 } Node;
 /*the struct Node is for the construction of expression tree*/
 
+typedef struct PackedNode {
+    unsigned int tag;
+    /*the type in the low byte and the operator in the byte above, see PACKED_TAG()*/
+    int left, right;
+    /*id of the left and right child, -1 for the leaves*/
+    union {
+        int number;
+        /*literal num if the type is N*/
+        int symbol;
+        /*symbol id if the type is V*/
+    } operand;
+} PackedNode;
+/*16 byte copy of a node without pointers, the store keeps them in one array indexed by id*/
+
+#define PACKED_TAG(type, operation) ((unsigned int)(unsigned char)(type) | (unsigned int)(unsigned char)(operation) << 8)
+#define PACKED_TYPE(tag) ((char)((tag) & 0xff))
+#define PACKED_OPERATOR(tag) ((char)((tag) >> 8 & 0xff))
+/*pack the type and the operator of a node into one tag and take them out again*/
+
+#define SYMBOL_BIT(symbol) (1ULL << ((symbol) & 63))
+/*the bit of a variable in a dependency set, variables whose symbol ids differ by a multiple of 64 share a bit*/
+/*so a set may claim a variable it doesn't have but never misses one, and it is empty exactly when there is no variable*/
+
+typedef struct NodeStore {
+    Node ** buckets;
+    /*hash buckets, chained through Node->next*/
+    int bucketCount;
+    /*number of buckets, always a power of two*/
+    int count;
+    /*number of distinct nodes, it is also the id of the next new node*/
+    PackedNode * packed;
+    /*the packed copy of every node, indexed by id*/
+    Node ** nodes;
+    /*the node of every id*/
+    unsigned long long * depends;
+    /*the variables every id depends on as SYMBOL_BIT()s, only tested for being empty (a constant subtree), which is exact*/
+    int capacity;
+    /*allocated length of packed, nodes and depends*/
+} NodeStore;
+/*a node is always made after its children, so the ids are in topological order and the*/
+/*packed array can be walked front to back (children first) or back to front (parents first) with no recursion*/
+/*hash-consing store, every node is unique on (type, operator, number, symbol, children)*/
+
+typedef struct SymbolTable {
+    char ** names;
+    /*the name of every symbol id, ended with '\0', in the expression arena*/
+    size_t * lengths;
+    /*the length of every name*/
+    unsigned int * hashes;
+    /*the hash of every name, kept so that growing the table never hashes a name again*/
+    int * slots;
+    /*open addressing table of symbol id + 1, 0 for an empty slot*/
+    int slotCount;
+    /*number of slots, always a power of two*/
+    int count;
+    /*number of symbols, it is also the id of the next new one*/
+    int capacity;
+    /*allocated length of names, lengths and hashes*/
+} SymbolTable;
+/*every distinct variable name of the expression gets a small integer id, so names are compared once*/
+
+typedef struct Token {
+    char type;
+    /*N, V or O*/
+    char operator;
+    /*the character of an operator or a parenthesis, '\0' for the other tokens*/
+    int length;
+    /*number of characters of the token*/
+    size_t offset;
+    /*position of the first character in the expression, the text is not copied*/
+    int value;
+    /*the value of a number, parsed once by the tokenizer, -1 for a number too large for an int*/
+} Token;
+/*one token, a view into the expression it was read from*/
+
 typedef struct TokenList {
-    char tokens[TOKEN_MAX_NUM][EXPR_MAX_LEN];
-    /*store the tokens*/
-    char types[TOKEN_MAX_NUM];
-    /*store the types of the tokens, N, V, O*/
+    char * source;
+    /*the expression the tokens point into, it has to live as long as the tokens are used*/
+    Token * tokens;
+    /*the tokens in the order of the input*/
     int count;
     /*count of the tokens*/
+    int capacity;
+    /*allocated number of token slots*/
 } TokenList;
-/*Implement a type of datastructure to store*/
+/*Implement a type of datastructure to store, a zeroed TokenList is an empty one and it grows as needed*/
+
+#define TOKEN_TEXT(list, i) ((list)->source + (list)->tokens[i].offset)
+/*the text of the i-th token, it is not ended with '\0', (list)->tokens[i].length characters long*/
+
+typedef struct VarList {
+    int * symbols;
+    /*the distinct symbol ids of the variables*/
+    int count;
+    /*number of variables*/
+    unsigned char * seen;
+    /*one bit per symbol id of the expression, set once the symbol is in the list*/
+} VarList;
+/*the variables collected from an expression, a zeroed VarList is an empty one, it lives in the expression arena*/
+
+typedef struct Rope {
+    size_t length;
+    /*total number of characters*/
+    char * text;
+    /*the characters of a leaf (not necessarily terminated), NULL for a concatenation*/
+    struct Rope * Left, * Right;
+    /*the two halves of a concatenation*/
+} Rope;
+/*immutable string made of shared pieces, so concatenation is O(1) and nothing is copied until printing*/
+
+extern Rope ropeZero;
+/*the constant expression 0*/
 
+typedef struct OutputBuffer {
+    char * data;
+    /*the text, not ended with '\0'*/
+    size_t length;
+    /*number of characters written*/
+    size_t capacity;
+    /*allocated length of data*/
+} OutputBuffer;
+/*growing text buffer, so the output of an expression can be produced away from stdout*/
+
+typedef struct MappedFile {
+    char * data;
+    /*the contents of the file, read-only and not ended with '\0', NULL for an empty file*/
+    size_t length;
+    /*size of the file*/
+    size_t released;
+    /*the pages before this offset have been handed back to the system*/
+} MappedFile;
+/*a whole file mapped into memory, so its lines can be used where they are without being copied*/
+
+typedef void (*TaskFunction)(void * arg);
+/*the work of one task of the thread pool*/
+
+typedef struct TaskGroup {
+    int pending;
+    /*number of submitted tasks that are not finished yet, protected by the pool*/
+} TaskGroup;
+/*a set of tasks that can be waited for together, start it at zero*/
+
+typedef struct ThreadPool ThreadPool;
+/*work-stealing thread pool, the details are private to pool.c*/
+
+typedef struct PolynomialSet PolynomialSet;
+/*the sparse polynomials of the nodes of one expression, the details are private to poly.c*/
+
+typedef struct Instruction {
+    char operation;
+    /*'N' loads a constant, 'V' an input, + - * / ^ combine two registers, 'l' (ln) and '~' (negation) take one*/
+    unsigned char needs;
+    /*1 if the left operand depends on an input, 2 if the right one does, the reverse sweep skips the others*/
+    int left, right;
+    /*the registers of the operands, the constant index of 'N' and the input slot of 'V' are in left*/
+} Instruction;
+/*one node of a compiled expression, its result goes into the register with the index of the instruction*/
+
+typedef struct Program {
+    Instruction * code;
+    /*one instruction per distinct node, operands always come before the instruction that uses them*/
+    int count;
+    /*number of instructions and of registers*/
+    double * constants;
+    int constantCount;
+    char ** names;
+    /*the name of every input slot, in the lexicographical order, copied so the program outlives the expression*/
+    int inputCount;
+    int * outputs;
+    /*the register of every compiled root*/
+    int outputCount;
+} Program;
+/*an expression compiled to a linear register tape, evaluated with no allocation and no text*/
+
+typedef struct DatasetTotals {
+    long rows;
+    /*rows that were evaluated*/
+    long failures;
+    /*rows that could not be read*/
+    double value;
+    /*the sum of the values over the rows*/
+    double * gradient;
+    /*the sum of the derivative by every input slot over the rows*/
+    int inputCount;
+} DatasetTotals;
+/*what evaluateDataset() sums up, the caller frees gradient*/
+
+typedef struct OptimizeBudget {
+    int nodes;
+    /*the most e-graph nodes one optimization may build*/
+    int rounds;
+    /*the most rounds of rewriting one optimization may run*/
+    int milliseconds;
+    /*the longest one optimization may rewrite, 0 for no limit, off by default since the result would depend on the timing*/
+    char cost;
+    /*'n' to count the nodes, 'e' to weigh them by what they cost to evaluate*/
+} OptimizeBudget;
+/*the limits of the e-graph optimizer, set once and read by every thread*/
+
+typedef struct TapeEntry {
+    Node * node;
+    /*the node of the expression tree that is recorded*/
+    Node * adjoint;
+    /*derivative of the root with respect to this node as a tree in the node store, filled in the adjoint sweep*/
+    int left, right;
+    /*tape index of the left and right child, -1 for the leaves*/
+} TapeEntry;
+/*one record of the gradient tape, children are always recorded before their parent*/
+
+typedef struct GradTape {
+    TapeEntry * entries;
+    /*the records in post order, so the root is the last one*/
+    int count;
+    /*number of records*/
+    int capacity;
+    /*allocated number of records*/
+    int * indexOf;
+    /*tape index of every recorded node id, -1 if it is not recorded, so shared nodes are recorded once*/
+    int indexCapacity;
+    /*allocated length of indexOf*/
+} GradTape;
+/*the tape is used by the reverse-mode engine to get all the derivatives in one backward pass*/
+
+void * arenaAlloc(Arena * arena, size_t size);
+/*take size bytes from the arena*/
+void * arenaCalloc(Arena * arena, size_t count, size_t size);
+/*take count * size bytes from the arena, set to zero*/
+void arenaReset(Arena * arena);
+/*drop everything in the arena in O(1), keeping the blocks for reuse*/
+void arenaDestroy(Arena * arena);
+/*give all the blocks of the arena back to the system*/
+Arena * expressionArena(void);
+/*the arena that owns the nodes and strings of the current expression*/
+void releaseExpression(void);
+/*drop every node and string of the current expression at once*/
+TokenList * threadTokenList(void);
+/*a tokenlist that belongs to the calling thread and is reused for all of its expressions*/
+void releaseThreadMemory(void);
+/*free the arena and tokenlist of the calling thread before it exits*/
+
+Rope * ropeText(char * text, size_t length);
+/*a rope of length characters at text, the characters are not copied*/
+Rope * ropeConcat(Rope * left, Rope * right);
+/*join two ropes in O(1)*/
+Rope * ropeBuild(char * fmt, ...);
+/*join literal text, %r ropes and %c characters into one rope*/
+void outputText(OutputBuffer * out, char * text, size_t length);
+/*append length characters to the buffer*/
+void outputFormat(OutputBuffer * out, char * fmt, ...);
+/*append printf-formatted text to the buffer*/
+void outputRope(OutputBuffer * out, Rope * rope);
+/*append the text of the rope to the buffer*/
+
+ThreadPool * createThreadPool(int workerCount);
+/*start a pool with workerCount threads, 0 means one per processor*/
+void destroyThreadPool(ThreadPool * pool);
+/*finish the queued tasks and stop the threads*/
+int poolWorkerCount(ThreadPool * pool);
+/*number of worker threads of the pool*/
+void poolSubmit(ThreadPool * pool, TaskGroup * group, TaskFunction run, void * arg);
+/*queue run(arg) as a task of the group*/
+void poolWait(ThreadPool * pool, TaskGroup * group);
+/*run queued tasks until every task of the group is finished*/
+int cpuCount(void);
+/*number of processors that are online*/
+
+long readExpression(FILE * file, char ** bufferPtr, size_t * capacityPtr);
+/*read one whole line of any length into the growing buffer, return its length or -1 at the end of the file*/
 void tokenize(char * expression, TokenList * tokenListPtr);
 /*the function to parse the expression and storage the tokens into our tokenlist*/
-Node * createNode(char type, char operation, int number, char * variable);
-/*it is used to create a node, assigning features to it.*/
+void tokenizeRange(char * expression, size_t length, TokenList * tokenListPtr);
+/*the same as tokenize(), for the first length characters of expression*/
+void tokenizeScalar(char * expression, size_t length, TokenList * tokenListPtr);
+/*the byte-at-a-time tokenizer, used where there is no SIMD and as the reference for the SIMD one*/
+const char * tokenizerName(void);
+/*the instruction set tokenizeRange() uses, "AVX2", "SSE2" or "scalar"*/
+void freeTokenList(TokenList * tokenListPtr);
+/*free the storage of the tokenlist, leaving an empty one*/
+Node * createNode(char type, char operation, int number, int symbol);
+/*it is used to create a leaf node, assigning features to it, symbol is -1 for anything but a variable*/
+Node * internNode(char type, char operation, int number, int symbol, Node * left, Node * right);
+/*return the unique node with these features and children, creating it only if it has not been seen*/
+int nodeStoreSize(void);
+/*number of distinct nodes in the node store*/
+NodeStore * currentNodeStore(void);
+/*the node store of the calling thread, tasks working on its expression are handed this pointer*/
+int largestId(Node ** roots, int count);
+/*the largest id of the roots, -1 if there are none*/
+void markReachable(NodeStore * store, Node ** roots, int count, unsigned char * reachable);
+/*set reachable[id] for every node under any of the roots (roots included), reachable needs largestId() + 1 zeroed bytes*/
+int internSymbol(char * name, size_t length);
+/*the symbol id of the length characters at name, a new id the first time the name is seen*/
+char * symbolName(int symbol);
+/*the name of the symbol, it lives as long as the expression*/
+size_t symbolLength(int symbol);
+/*the length of the name of the symbol*/
+int symbolCount(void);
+/*number of distinct variable names in the expression*/
 int getPrecedence(char op);
 /*return the precedence of various operators*/
 bool isOperator(char c);
 /*determine whether c is an operator*/
 void setChildren(Node * parent, Node * left, Node * right);
-/*set the parent of Node left and right, and set the children of the current node*/
+/*set the children of the current node*/
 Node * createExpressionTree(TokenList * tokenListPtr);
 /*use the tokenlist to create an expression tree*/
+int postfixOrder(TokenList * tokenListPtr, int from, int to, int * order, int * opStack);
+/*put the tokens from..to-1 into the order the nodes are built in, return the count or -1 for an invalid expression*/
+/*order and opStack need room for to - from entries*/
+Node * nodeFromPostfix(TokenList * tokenListPtr, int * order, int count);
+/*build the nodes in the order given by postfixOrder() and return the root*/
+Node * parseExpression(char * expression, size_t length, TokenList * tokenListPtr);
+/*tokenize the length characters of the expression and build its tree, NULL if it is invalid*/
+Node * parseParallel(ThreadPool * pool, char * expression, size_t length, TokenList * tokenListPtr);
+/*the same tree as tokenize() and createExpressionTree(), with the tokens and the order found by tasks of the pool*/
 void calculateGrad(Node * root);
 /*sort the variables with lexicographical order and output their corresponding derivative*/
-char* getNodeExpr(Node* node);
-/*get the expression of the node*/
+void calculateGradTo(Node * root, OutputBuffer * out);
+/*the same as calculateGrad(), but the text is appended to the buffer*/
+void setGradPool(ThreadPool * pool);
+/*let calculateGrad() spread the work of the variables over the pool, NULL to stay on the calling thread*/
+void setGradOptimizer(const OptimizeBudget * budget);
+/*let calculateGrad() run the e-graph optimizer on the derivatives, NULL to only simplify them*/
+Rope* getNodeExpr(Node* node);
+/*get the expression of the node, rendered once and cached on the node, the rope lives in the expression arena*/
 char* formatExpr(char* fmt, ...);
 /*unified format expression function, no matter what is the length*/
-void collectVariables(Node* node, char** vars, int* count);
-/*collect all the variables in the expression*/
-char* derive(Node* node, char* var);
-/*calculate the derivative of variables*/
-int compareStrings(char * a, char * b);
-/*compare the lexicographical order of strings, used in qsort()*/
+void collectVariables(Node** roots, int count, VarList* list);
+/*collect all the variables of the expressions, the list remembers what it has seen*/
+void simplifyAll(Node** roots, int count);
+/*rewrite every root in place by the algebraic rules until nothing changes: constants folded, identities removed,*/
+/*like terms and powers collected, the nodes they share are simplified once*/
+void optimizeAll(Node** roots, int count, const OptimizeBudget* budget);
+/*replace every root by the cheapest equal form that equality saturation finds within the budget*/
+PolynomialSet* beginPolynomials(void);
+/*an empty set of polynomials for the nodes of the current expression, it lives in the expression arena*/
+int polynomialGradient(PolynomialSet* set, Node* node, int* position, Node** gradient, int* slots);
+/*if the node is a polynomial of acceptable size, put its derivative by every symbol s with position[s] >= 0 into gradient[position[s]]*/
+/*in canonical collapsed form and the positions into slots, return how many, or -1 to leave the node to the general rules*/
+void recordTape(Node** roots, int count, GradTape* tape, int* indices);
+/*forward sweep, record the nodes of all the roots children first, put the index of roots[k] into indices[k] unless indices is NULL*/
+void backward(GradTape* tape, int* vars, int varCount, Node** partials);
+/*adjoint sweep, get the derivative of every variable (sorted symbol ids) in a single pass over the tape*/
+void freeTape(GradTape* tape);
+/*free the records of the tape, its adjoints belong to the expression arena*/
+Program * compileProgram(Node ** roots, int count);
+/*compile the roots into one program, the pieces they share are computed once, the inputs are all their variables*/
+void freeProgram(Program * program);
+/*free the program and everything in it*/
+int programInput(Program * program, char * name, size_t length);
+/*the input slot of the variable, -1 if the program doesn't use it*/
+void evaluateProgram(const Program * program, const double * inputs, double * registers);
+/*compute every register from the inputs (one value per input slot), registers needs program->count entries*/
+double gradientProgram(const Program * program, int output, const double * inputs, double * registers, double * adjoints, double * gradient);
+/*evaluate and then sweep the tape backwards, return the value of the output and put its derivative by every input into gradient*/
+/*adjoints needs program->count entries, gradient program->inputCount*/
+void evaluateColumns(const Program * program, int output, const double * const * columns, long rows, double * values, double ** gradient);
+/*the output and its gradient for rows points, columns[s] holds the rows of input slot s and gradient[s] gets its derivative*/
+/*the rows go through the tape in blocks with SIMD vectors, gradient can be NULL for the values only*/
+void evaluateColumnsFloat(const Program * program, int output, const float * const * columns, long rows, float * values, float ** gradient);
+/*evaluateColumns() in single precision, twice the rows per vector*/
+const char * columnSimdName(void);
+/*the instruction set evaluateColumns() uses, "AVX-512", "AVX2" or "scalar"*/
+bool evaluateDataset(FILE * file, const Program * program, int workerCount, DatasetTotals * totals);
+/*stream a CSV file with a header line of names, or a binary one (GRADCOLS, the header line, rows of doubles), in chunks*/
+/*and sum the value and the gradient of the program over all the rows on workerCount threads, false if a column is missing*/
+int compareSymbols(const void * a, const void * b);
+/*compare the lexicographical order of the names of two symbol ids, used in qsort()*/
+bool processExpression(char * expression, size_t length, TokenList * tokenListPtr, OutputBuffer * out);
+/*tokenize, build and differentiate one expression into out, return false if it is invalid*/
+long runBatch(FILE * input, int workerCount);
+/*differentiate every line of the input in input order, with workerCount threads (0 for one per processor), return the number of invalid lines*/
+long runBatchMapped(MappedFile * file, int workerCount);
+/*the same as runBatch(), with the lines used in place in the mapped file*/
+
+bool mapFile(const char * path, MappedFile * file);
+/*map the whole file for reading, false if it cannot be mapped (a pipe, for example)*/
+void releaseMappedBefore(MappedFile * file, size_t offset);
+/*the lines before offset are done, let the system drop their pages*/
+void unmapFile(MappedFile * file);
+/*unmap the file*/
 #endif
\ No newline at end of file
@@ -8,30 +8,275 @@
 #include "header.h"
 /*necessary header files included*/
 
-int main()
+static OptimizeBudget optimizeBudget = {OPTIMIZE_NODE_BUDGET, OPTIMIZE_ROUND_BUDGET, 0, 'e'};
+/*the budget of --optimize, the derivatives are weighed by their evaluation cost unless --optimize-cost nodes is given*/
+/*only the nodes and the rounds are limited unless --optimize-time is given, so the same input gives the same output*/
+
+static bool readOptimizeOption(int argc, char * argv[], int * i)
+/*take the optimizer option at argv[*i] and its value, return false if it is not one*/
+{
+    if (strcmp(argv[*i], "--optimize") == 0)
+    {
+        setGradOptimizer(&optimizeBudget);
+        return true;
+    }
+    if (*i + 1 >= argc)
+    {
+        return false;
+    }
+    if (strcmp(argv[*i], "--optimize-nodes") == 0)
+    {
+        optimizeBudget.nodes = atoi(argv[++*i]);
+    }
+    else if (strcmp(argv[*i], "--optimize-rounds") == 0)
+    {
+        optimizeBudget.rounds = atoi(argv[++*i]);
+    }
+    else if (strcmp(argv[*i], "--optimize-time") == 0)
+    {
+        optimizeBudget.milliseconds = atoi(argv[++*i]);
+    }
+    else if (strcmp(argv[*i], "--optimize-cost") == 0)
+    {
+        optimizeBudget.cost = strcmp(argv[++*i], "nodes") == 0 ? 'n' : 'e';
+    }
+    else
+    {
+        return false;
+    }
+    setGradOptimizer(&optimizeBudget);
+    /*giving a budget turns the optimizer on as well*/
+    return true;
+}
+
+static void printAt(Node * root, char * assignments)
+/*the value and the gradient of the expression at the point given as name=value,name=value*/
+{
+    Program * program = compileProgram(&root, 1);
+    double * inputs = (double *)calloc(program->inputCount + 1, sizeof(double));
+    bool * given = (bool *)calloc(program->inputCount + 1, sizeof(bool));
+    for (char * piece = assignments; *piece != '\0'; )
+    {
+        size_t length = strcspn(piece, ",");
+        char * equals = (char *)memchr(piece, '=', length);
+        if (equals != NULL)
+        {
+            int slot = programInput(program, piece, equals - piece);
+            if (slot >= 0)
+            {
+                inputs[slot] = strtod(equals + 1, NULL);
+                given[slot] = true;
+            }
+            /*a name the expression doesn't have is ignored*/
+        }
+        piece += length + (piece[length] == ',' ? 1 : 0);
+    }
+    bool complete = true;
+    for (int i = 0; i < program->inputCount; i++)
+    {
+        if (!given[i])
+        {
+            printf("No value for %s\n", program->names[i]);
+            complete = false;
+        }
+    }
+    if (complete)
+    {
+        double * registers = (double *)malloc((program->count + 1) * sizeof(double));
+        double * adjoints = (double *)malloc((program->count + 1) * sizeof(double));
+        double * gradient = (double *)malloc((program->inputCount + 1) * sizeof(double));
+        printf("value = %.17g\n", gradientProgram(program, 0, inputs, registers, adjoints, gradient));
+        for (int i = 0; i < program->inputCount; i++)
+        {
+            printf("d/d%s = %.17g\n", program->names[i], gradient[i]);
+        }
+        free(gradient);
+        free(adjoints);
+        free(registers);
+    }
+    free(given);
+    free(inputs);
+    freeProgram(program);
+}
+
+static int runDataset(int argc, char * argv[])
+/*dataset mode: the expression from the command line or from stdin, summed with its gradient over the rows of the file*/
 {
-    char * inputExpr = (char *)calloc(50, sizeof(char));
-    /*initialize the input string*/
+    char * path = argv[2];
+    char * text = NULL;
+    size_t capacity = 0;
+    int workerCount = 0;
+    /*one thread per processor unless --threads is given*/
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            workerCount = atoi(argv[++i]);
+        }
+        else if (text == NULL)
+        {
+            text = argv[i];
+        }
+    }
+    bool ownText = text == NULL;
+    if (ownText && readExpression(stdin, &text, &capacity) < 0)
+    {
+        return 1;
+    }
+    FILE * file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return 1;
+    }
+    size_t length = strcspn(text, "\r\n");
+    Node * root = parseExpression(text, length, threadTokenList());
+    if (root == NULL)
+    {
+        printf("Invalid input\n");
+        fclose(file);
+        return 1;
+    }
+    Program * program = compileProgram(&root, 1);
+    releaseExpression();
+    /*the program keeps the names of its inputs, the tree is not needed any more*/
+    DatasetTotals totals;
+    bool complete = evaluateDataset(file, program, workerCount, &totals);
+    fclose(file);
+    if (complete)
+    {
+        printf("rows: %ld\n", totals.rows);
+        printf("value: %.17g\n", totals.value);
+        for (int i = 0; i < program->inputCount; i++)
+        {
+            printf("%s: %.17g\n", program->names[i], totals.gradient[i]);
+        }
+    }
+    free(totals.gradient);
+    freeProgram(program);
+    if (ownText)
+    {
+        free(text);
+    }
+    return complete && totals.failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc >= 3 && strcmp(argv[1], "--dataset") == 0)
+    {
+        return runDataset(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--batch") == 0)
+    /*batch mode: one expression per line, from the named file or from stdin*/
+    {
+        char * path = NULL;
+        int workerCount = 1;
+        /*one thread unless --threads is given, 0 means one per processor*/
+        for (int i = 2; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            {
+                workerCount = atoi(argv[++i]);
+            }
+            else if (readOptimizeOption(argc, argv, &i))
+            {
+                continue;
+            }
+            else if (path == NULL)
+            {
+                path = argv[i];
+            }
+        }
+        if (optimizeBudget.milliseconds > 0)
+        {
+            fprintf(stderr, "--optimize-time is ignored in batch mode, the output must not depend on the timing\n");
+            optimizeBudget.milliseconds = 0;
+        }
+        long failures;
+        MappedFile mapped;
+        if (path == NULL)
+        {
+            failures = runBatch(stdin, workerCount);
+        }
+        else if (mapFile(path, &mapped))
+        /*a regular file is mapped and its lines are tokenized where they are*/
+        {
+            failures = runBatchMapped(&mapped, workerCount);
+            unmapFile(&mapped);
+        }
+        else
+        {
+            FILE * input = fopen(path, "r");
+            if (input == NULL)
+            {
+                fprintf(stderr, "Cannot open %s\n", path);
+                return 1;
+            }
+            failures = runBatch(input, workerCount);
+            fclose(input);
+        }
+        return failures > 0 ? 1 : 0;
+    }
+
+    char * inputExpr = NULL;
+    size_t inputCapacity = 0;
+    /*initialize the input string, it grows with the length of the input*/
     TokenList * tokenListPtr = (TokenList * )calloc(1, sizeof(TokenList));
     /*create the tokenlist to store tokens that are extracted from the expression*/
-    Node * rootPtr = (Node * )calloc(1, sizeof(Node));
-    /*malloc memory for the input expression*/
+    Node * rootPtr = NULL;
+    /*the root of the expression tree, its nodes are owned by the expression arena*/
+    ThreadPool * pool = NULL;
+    char * point = NULL;
+    /*the assignment given with --at, the gradient is then also worked out as numbers there*/
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && pool == NULL)
+        /*interactive mode with the work of the variables spread over threads, 0 means one per processor*/
+        {
+            pool = createThreadPool(atoi(argv[++i]));
+            setGradPool(pool);
+        }
+        else if (strcmp(argv[i], "--at") == 0 && i + 1 < argc)
+        {
+            point = argv[++i];
+        }
+        else
+        {
+            readOptimizeOption(argc, argv, &i);
+        }
+    }
     printf("Please input the expression: ");
     /*user input prompt*/
-    fgets(inputExpr, EXPR_MAX_LEN, stdin);
-    /*get the expression from the user*/
-    tokenize(inputExpr, tokenListPtr);
-    /*tokenize the input expression string*/
-    rootPtr = createExpressionTree(tokenListPtr);
+    if (readExpression(stdin, &inputExpr, &inputCapacity) < 0)
+    {
+        return 0;
+        /*nothing is input*/
+    }
+    /*get the expression from the user, no matter how long it is*/
+    rootPtr = parseExpression(inputExpr, strlen(inputExpr), tokenListPtr);
+    /*tokenize the input expression string and build the tree, on the pool if it is huge*/
     if (rootPtr == NULL)
     /*which means that the expression tree is not successfully created*/
     {
+        printf("Invalid input\n");
         return 0;
     }
     else
     {
         calculateGrad(rootPtr);
         /*calculate the gradient of every variable inside*/
+        if (point != NULL)
+        {
+            printAt(rootPtr, point);
+        }
+    }
+    releaseExpression();
+    /*the nodes and strings of the expression are all released at once*/
+    if (pool != NULL)
+    {
+        setGradPool(NULL);
+        destroyThreadPool(pool);
     }
     getchar();
     /*used to avoid the terminal from directly shutting down*/
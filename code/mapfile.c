@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "header.h"
+
+/*necessary header files included*/
+
+bool mapFile(const char *path, MappedFile *file)
+{
+    memset(file, 0, sizeof(MappedFile));
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    /*the sequential flag is the read-ahead hint of Windows*/
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || GetFileType(handle) != FILE_TYPE_DISK) {
+        CloseHandle(handle);
+        return false;
+    }
+    file->length = (size_t)size.QuadPart;
+    if (file->length > 0) {
+        HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL) {
+            file->data = (char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+            /*the view keeps the mapping alive*/
+        }
+    }
+    CloseHandle(handle);
+#else
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(descriptor, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(descriptor);
+        return false;
+        /*pipes and terminals cannot be mapped, they are read with stdio*/
+    }
+    file->length = (size_t)info.st_size;
+    if (file->length > 0) {
+        void *data = mmap(NULL, file->length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        file->data = data == MAP_FAILED ? NULL : (char *)data;
+    }
+    close(descriptor);
+    /*the mapping stays valid after the descriptor is closed*/
+    if (file->data != NULL) {
+#ifdef MADV_SEQUENTIAL
+        madvise(file->data, file->length, MADV_SEQUENTIAL);
+        /*read ahead aggressively, pages behind the reader can go early*/
+#endif
+#ifdef MADV_HUGEPAGE
+        madvise(file->data, file->length, MADV_HUGEPAGE);
+        /*only a hint, file systems without huge pages for files ignore it*/
+#endif
+    }
+#endif
+    return file->length == 0 || file->data != NULL;
+}
+
+void releaseMappedBefore(MappedFile *file, size_t offset)
+{
+#if !defined(_WIN32) && defined(MADV_DONTNEED)
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t end = offset / pageSize * pageSize;
+    if (end > file->released) {
+        madvise(file->data + file->released, end - file->released, MADV_DONTNEED);
+        file->released = end;
+        /*the pages are clean copies of the file, dropping them only costs a read if they are touched again*/
+    }
+#else
+    (void)file;
+    (void)offset;
+    /*Windows trims the working set of a sequential view by itself*/
+#endif
+}
+
+void unmapFile(MappedFile *file)
+{
+    if (file->data != NULL) {
+#ifdef _WIN32
+        UnmapViewOfFile(file->data);
+#else
+        munmap(file->data, file->length);
+#endif
+    }
+    memset(file, 0, sizeof(MappedFile));
+}
@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <limits.h>
+#include <string.h>
+#include "header.h"
+
+/*necessary header files included*/
+
+#define PARSE_CHUNK_MIN (64 * 1024)
+/*the smallest piece of text that is worth a task*/
+#define CHUNKS_PER_WORKER 4
+/*a few chunks per worker, so a slow chunk does not hold the others up*/
+
+typedef struct ParseChunk {
+    char *text;
+    /*the piece of the expression, never cut in the middle of a token*/
+    size_t length;
+    /*number of characters of the piece*/
+    TokenList tokens;
+    /*the tokens of the piece, before they are merged*/
+    int depthChange;
+    /*how much deeper the parentheses are at the end of the piece than at its start*/
+    int lowestDepth;
+    /*the lowest depth inside the piece, relative to its start*/
+    int firstToken, tokenCount;
+    /*index of its first token in the merged list and number of its tokens, from the prefix sum*/
+    int startDepth;
+    /*depth at its start, from the prefix sum*/
+    int operatorDepth;
+    /*lowest depth of an operator in the piece, INT_MAX if there is none*/
+    int splitPrecedence;
+    /*lowest precedence of the operators at the split depth, INT_MAX if there is none*/
+    int splitCount;
+    /*number of operators with that precedence, their indices are in the shared split list*/
+} ParseChunk;
+
+typedef struct ParseState {
+    TokenList *tokens;
+    /*the merged tokens of the whole expression*/
+    int *depths;
+    /*depth of the parentheses around every token*/
+    int *splits;
+    /*operators at the split depth, every chunk writes from its own first token on*/
+    int splitDepth;
+    /*depth of the operators the expression is split at*/
+    int from, to;
+    /*the tokens inside the parentheses that wrap the whole expression*/
+    int *segmentStart, *segmentEnd, *orderCount;
+    /*token range of every segment between two splits, and the length of its order*/
+    int *order, *opStack;
+    /*the order of every segment is written over the same range as its tokens*/
+} ParseState;
+
+typedef struct ParseTask {
+    ParseState *state;
+    ParseChunk *chunk;
+    /*the chunk for the first three phases*/
+    int firstSegment, lastSegment;
+    /*the segments for the last phase*/
+} ParseTask;
+
+static bool isNameChar(char c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+static bool isParenthesis(TokenList *tokens, int i, char c)
+{
+    return tokens->tokens[i].operator == c;
+}
+
+static void tokenizeChunk(void *arg)
+/*first phase, the tokens of the chunk and how it changes the depth*/
+{
+    ParseChunk *chunk = ((ParseTask *)arg)->chunk;
+    tokenizeRange(chunk->text, chunk->length, &chunk->tokens);
+    int depth = 0, lowest = 0;
+    for (int i = 0; i < chunk->tokens.count; i++) {
+        if (isParenthesis(&chunk->tokens, i, '(')) {
+            depth++;
+        }
+        else if (isParenthesis(&chunk->tokens, i, ')')) {
+            depth--;
+            if (depth < lowest) {
+                lowest = depth;
+            }
+        }
+    }
+    chunk->depthChange = depth;
+    chunk->lowestDepth = lowest;
+}
+
+static void mergeChunk(void *arg)
+/*second phase, copy the tokens to their place in the merged list and give each of them its depth*/
+{
+    ParseTask *task = (ParseTask *)arg;
+    ParseChunk *chunk = task->chunk;
+    TokenList *tokens = task->state->tokens;
+    size_t textOffset = chunk->text - tokens->source;
+    int depth = chunk->startDepth;
+    chunk->operatorDepth = INT_MAX;
+    for (int i = 0; i < chunk->tokens.count; i++) {
+        int index = chunk->firstToken + i;
+        tokens->tokens[index] = chunk->tokens.tokens[i];
+        tokens->tokens[index].offset += textOffset;
+        /*the chunk counted from its own start, the merged list from the start of the expression*/
+        if (isParenthesis(&chunk->tokens, i, ')')) {
+            depth--;
+        }
+        task->state->depths[index] = depth;
+        /*a parenthesis gets the depth outside of it, everything else the depth it is in*/
+        if (isParenthesis(&chunk->tokens, i, '(')) {
+            depth++;
+        }
+        else if (chunk->tokens.tokens[i].type == TOKEN_IS_OPERATOR && !isParenthesis(&chunk->tokens, i, ')') && depth < chunk->operatorDepth) {
+            chunk->operatorDepth = depth;
+        }
+    }
+    freeTokenList(&chunk->tokens);
+}
+
+static void findSplits(void *arg)
+/*third phase, the operators of lowest precedence at the split depth*/
+{
+    ParseTask *task = (ParseTask *)arg;
+    ParseChunk *chunk = task->chunk;
+    ParseState *state = task->state;
+    TokenList *tokens = state->tokens;
+    int first = chunk->firstToken > state->from ? chunk->firstToken : state->from;
+    int last = chunk->firstToken + chunk->tokenCount < state->to ? chunk->firstToken + chunk->tokenCount : state->to;
+    chunk->splitPrecedence = INT_MAX;
+    chunk->splitCount = 0;
+    for (int i = first; i < last; i++) {
+        if (state->depths[i] != state->splitDepth || tokens->tokens[i].type != TOKEN_IS_OPERATOR
+            || isParenthesis(tokens, i, '(') || isParenthesis(tokens, i, ')')) {
+            continue;
+        }
+        int precedence = getPrecedence(tokens->tokens[i].operator);
+        if (precedence < chunk->splitPrecedence) {
+            chunk->splitPrecedence = precedence;
+            chunk->splitCount = 0;
+            /*a lower operator is found, the ones before are not splits any more*/
+        }
+        if (precedence == chunk->splitPrecedence) {
+            state->splits[chunk->firstToken + chunk->splitCount++] = i;
+        }
+    }
+}
+
+static void orderSegments(void *arg)
+/*last phase, the order of the nodes of every segment, which is the expensive part of the parsing*/
+{
+    ParseTask *task = (ParseTask *)arg;
+    ParseState *state = task->state;
+    for (int k = task->firstSegment; k <= task->lastSegment; k++) {
+        int start = state->segmentStart[k];
+        state->orderCount[k] = postfixOrder(state->tokens, start, state->segmentEnd[k], state->order + start, state->opStack + start);
+    }
+}
+
+static void runPhase(ThreadPool *pool, TaskFunction run, ParseTask *tasks, int count)
+{
+    TaskGroup group = {0};
+    for (int i = 0; i < count; i++) {
+        poolSubmit(pool, &group, run, &tasks[i]);
+    }
+    poolWait(pool, &group);
+    /*the tasks only write to their own chunk or range, the join is the only synchronization*/
+}
+
+static void reserveTokens(TokenList *tokens, char *source, int count)
+{
+    if (count > tokens->capacity) {
+        tokens->capacity = count;
+        tokens->tokens = (Token *)realloc(tokens->tokens, count * sizeof(Token));
+    }
+    tokens->source = source;
+    tokens->count = count;
+}
+
+Node *parseParallel(ThreadPool *pool, char *expression, size_t length, TokenList *tokenListPtr)
+{
+    int chunkCount = poolWorkerCount(pool) * CHUNKS_PER_WORKER;
+    if ((size_t)chunkCount > length / PARSE_CHUNK_MIN) {
+        chunkCount = length / PARSE_CHUNK_MIN > 0 ? (int)(length / PARSE_CHUNK_MIN) : 1;
+    }
+    ParseChunk *chunks = (ParseChunk *)arenaCalloc(expressionArena(), chunkCount, sizeof(ParseChunk));
+    ParseTask *tasks = (ParseTask *)arenaCalloc(expressionArena(), chunkCount, sizeof(ParseTask));
+    ParseState state;
+    memset(&state, 0, sizeof(state));
+    state.tokens = tokenListPtr;
+    size_t start = 0;
+    for (int c = 0; c < chunkCount; c++) {
+        size_t end = c == chunkCount - 1 ? length : (size_t)((double)length * (c + 1) / chunkCount);
+        while (end > start && end < length && isNameChar(expression[end - 1]) && isNameChar(expression[end])) {
+            end++;
+            /*move the cut past the name or number it would split*/
+        }
+        chunks[c].text = expression + start;
+        chunks[c].length = end - start;
+        tasks[c].state = &state;
+        tasks[c].chunk = &chunks[c];
+        start = end;
+    }
+    runPhase(pool, tokenizeChunk, tasks, chunkCount);
+
+    int tokenCount = 0, depth = 0;
+    bool balanced = true;
+    for (int c = 0; c < chunkCount; c++) {
+        chunks[c].firstToken = tokenCount;
+        chunks[c].tokenCount = chunks[c].tokens.count;
+        chunks[c].startDepth = depth;
+        if (depth + chunks[c].lowestDepth < 0) {
+            balanced = false;
+        }
+        tokenCount += chunks[c].tokens.count;
+        depth += chunks[c].depthChange;
+    }
+    /*the prefix sum over the chunks gives every chunk its place and its depth*/
+    balanced = balanced && depth == 0;
+    reserveTokens(tokenListPtr, expression, tokenCount);
+    state.depths = (int *)arenaAlloc(expressionArena(), (tokenCount + 1) * sizeof(int));
+    runPhase(pool, mergeChunk, tasks, chunkCount);
+
+    int splitDepth = INT_MAX;
+    for (int c = 0; c < chunkCount; c++) {
+        splitDepth = chunks[c].operatorDepth < splitDepth ? chunks[c].operatorDepth : splitDepth;
+    }
+    if (!balanced || splitDepth == INT_MAX || 2 * splitDepth > tokenCount) {
+        return createExpressionTree(tokenListPtr);
+        /*unbalanced parentheses or no operator at all, the serial parser decides what to build*/
+    }
+    state.splitDepth = splitDepth;
+    state.from = splitDepth;
+    state.to = tokenCount - splitDepth;
+    for (int i = 0; i < tokenCount; i++) {
+        bool outside = i < state.from || i >= state.to;
+        if ((i < state.from && !isParenthesis(tokenListPtr, i, '('))
+            || (i >= state.to && !isParenthesis(tokenListPtr, i, ')'))
+            || (!outside && state.depths[i] < splitDepth)) {
+            return createExpressionTree(tokenListPtr);
+            /*the operators are not all inside one pair of parentheses around the whole expression*/
+        }
+    }
+    /*one pass over the depths, far cheaper than the tokenizing and ordering around it*/
+    state.splits = (int *)arenaAlloc(expressionArena(), (tokenCount + 1) * sizeof(int));
+    runPhase(pool, findSplits, tasks, chunkCount);
+
+    int splitPrecedence = INT_MAX, splitCount = 0;
+    for (int c = 0; c < chunkCount; c++) {
+        splitPrecedence = chunks[c].splitPrecedence < splitPrecedence ? chunks[c].splitPrecedence : splitPrecedence;
+    }
+    int *splits = (int *)arenaAlloc(expressionArena(), (tokenCount + 1) * sizeof(int));
+    for (int c = 0; c < chunkCount; c++) {
+        if (chunks[c].splitPrecedence == splitPrecedence) {
+            memcpy(splits + splitCount, state.splits + chunks[c].firstToken, chunks[c].splitCount * sizeof(int));
+            splitCount += chunks[c].splitCount;
+        }
+    }
+    /*the operators that split the expression, in the order of the input*/
+
+    int segmentCount = splitCount + 1;
+    state.segmentStart = (int *)arenaAlloc(expressionArena(), segmentCount * sizeof(int));
+    state.segmentEnd = (int *)arenaAlloc(expressionArena(), segmentCount * sizeof(int));
+    state.orderCount = (int *)arenaAlloc(expressionArena(), segmentCount * sizeof(int));
+    for (int k = 0; k < segmentCount; k++) {
+        state.segmentStart[k] = k == 0 ? state.from : splits[k - 1] + 1;
+        state.segmentEnd[k] = k == splitCount ? state.to : splits[k];
+    }
+    state.order = (int *)arenaAlloc(expressionArena(), (tokenCount + 1) * sizeof(int));
+    state.opStack = (int *)arenaAlloc(expressionArena(), (tokenCount + 1) * sizeof(int));
+    int taskCount = 0, first = 0;
+    int share = (state.to - state.from) / chunkCount + 1;
+    for (int k = 0; k < segmentCount; k++) {
+        if (k == segmentCount - 1 || state.segmentEnd[k] - state.segmentStart[first] >= share) {
+            tasks[taskCount].firstSegment = first;
+            tasks[taskCount].lastSegment = k;
+            taskCount++;
+            first = k + 1;
+            /*consecutive segments are grouped into tasks of about the same number of tokens*/
+        }
+    }
+    runPhase(pool, orderSegments, tasks, taskCount);
+
+    for (int k = 0; k < segmentCount; k++) {
+        if (state.orderCount[k] < 0) {
+            return createExpressionTree(tokenListPtr);
+            /*a segment that is no expression on its own, like 7x in 7x+, can still be one with its neighbours*/
+            /*whether it is and what it builds is left to the serial parser*/
+        }
+    }
+    Node *root = NULL;
+    for (int k = 0; k < segmentCount; k++) {
+        Node *node = nodeFromPostfix(tokenListPtr, state.order + state.segmentStart[k], state.orderCount[k]);
+        root = k == 0 ? node : internNode(TOKEN_IS_OPERATOR, tokenListPtr->tokens[splits[k - 1]].operator, 0, -1, root, node);
+        /*the split operators have the lowest precedence and group from the left, as in the serial parser*/
+        /*the nodes are interned on this thread in the serial order, so they are shared and numbered the same*/
+    }
+    return root;
+}
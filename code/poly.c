@@ -0,0 +1,690 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include "header.h"
+
+/*necessary header files included*/
+
+typedef struct Polynomial {
+    int count;
+    /*number of terms, none for the zero polynomial*/
+    long long *coefficients;
+    int *offsets;
+    /*the factors of term i are symbols[offsets[i]] up to offsets[i + 1], sorted by symbol id*/
+    int *symbols, *powers;
+} Polynomial;
+/*a sparse polynomial: the exponent vector of every term with its integer coefficient*/
+
+typedef struct PolyBuilder {
+    int count, capacity;
+    long long *coefficients;
+    int *offsets;
+    int factorCount, factorCapacity;
+    int *symbols, *powers;
+    int *table;
+    /*open addressing from a monomial to its term index + 1, so like terms are collected as they come*/
+    int tableSize;
+    bool failed;
+    /*too many terms or a coefficient that overflows, the polynomial is given up*/
+} PolyBuilder;
+
+struct PolynomialSet {
+    Polynomial **polys;
+    /*the polynomial of every node id below limit that has been worked out*/
+    unsigned char *state;
+    /*0 if the node has not been looked at, 1 if polys has it, 2 if it is not a polynomial (or too big)*/
+    unsigned char *declined;
+    /*1 for the sums inside a sum that was not expanded, their pieces are tried one by one instead*/
+    int limit;
+    int *ranks;
+    /*the position of every symbol in the lexicographical order, the canonical order of the factors*/
+};
+
+#define POLY_WALK_MAX (1 << 26)
+/*the most nodes one sum is walked through, a sum shared many times over inside itself is given up*/
+
+static unsigned int hashMonomial(int *symbols, int *powers, int length)
+{
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned int)symbols[i]) * 16777619u;
+        hash = (hash ^ (unsigned int)powers[i]) * 16777619u;
+    }
+    hash ^= hash >> 15;
+    return hash;
+}
+
+static bool addChecked(long long a, long long b, long long *sum)
+{
+    if ((b > 0 && a > LLONG_MAX - b) || (b < 0 && a < -LLONG_MAX - b)) {
+        return false;
+    }
+    *sum = a + b;
+    return true;
+}
+
+static bool multiplyChecked(long long a, long long b, long long *product)
+{
+    if (a != 0 && b != 0) {
+        long long absA = a < 0 ? -a : a, absB = b < 0 ? -b : b;
+        if (absA > LLONG_MAX / absB) {
+            return false;
+        }
+    }
+    *product = a * b;
+    return true;
+}
+
+static void builderInit(PolyBuilder *builder)
+{
+    memset(builder, 0, sizeof(PolyBuilder));
+    builder->tableSize = 64;
+    builder->table = (int *)calloc(builder->tableSize, sizeof(int));
+    builder->offsets = (int *)malloc(sizeof(int));
+    builder->offsets[0] = 0;
+}
+
+static void builderFree(PolyBuilder *builder)
+{
+    free(builder->coefficients);
+    free(builder->offsets);
+    free(builder->symbols);
+    free(builder->powers);
+    free(builder->table);
+}
+
+static bool sameMonomial(PolyBuilder *builder, int term, int *symbols, int *powers, int length)
+{
+    int start = builder->offsets[term];
+    if (builder->offsets[term + 1] - start != length) {
+        return false;
+    }
+    return length == 0 || (memcmp(builder->symbols + start, symbols, length * sizeof(int)) == 0
+                           && memcmp(builder->powers + start, powers, length * sizeof(int)) == 0);
+}
+
+static void growTable(PolyBuilder *builder)
+{
+    free(builder->table);
+    builder->tableSize *= 2;
+    builder->table = (int *)calloc(builder->tableSize, sizeof(int));
+    for (int term = 0; term < builder->count; term++) {
+        int start = builder->offsets[term];
+        unsigned int slot = hashMonomial(builder->symbols + start, builder->powers + start, builder->offsets[term + 1] - start);
+        slot &= builder->tableSize - 1;
+        while (builder->table[slot] != 0) {
+            slot = (slot + 1) & (builder->tableSize - 1);
+        }
+        builder->table[slot] = term + 1;
+    }
+}
+
+static void builderAdd(PolyBuilder *builder, long long coefficient, int *symbols, int *powers, int length)
+/*add the term to the polynomial, a term with the same monomial just gets the coefficient added*/
+{
+    if (builder->failed || coefficient == 0) {
+        return;
+    }
+    unsigned int slot = hashMonomial(symbols, powers, length) & (builder->tableSize - 1);
+    while (builder->table[slot] != 0) {
+        int term = builder->table[slot] - 1;
+        if (sameMonomial(builder, term, symbols, powers, length)) {
+            if (!addChecked(builder->coefficients[term], coefficient, &builder->coefficients[term])) {
+                builder->failed = true;
+            }
+            return;
+        }
+        slot = (slot + 1) & (builder->tableSize - 1);
+    }
+    if (builder->count >= POLY_MAX_TERMS) {
+        builder->failed = true;
+        return;
+        /*the expansion is too big, the tree is differentiated as it is*/
+    }
+    if (builder->count == builder->capacity) {
+        builder->capacity = builder->capacity ? builder->capacity * 2 : 16;
+        builder->coefficients = (long long *)realloc(builder->coefficients, builder->capacity * sizeof(long long));
+        builder->offsets = (int *)realloc(builder->offsets, (builder->capacity + 1) * sizeof(int));
+    }
+    if (builder->factorCount + length > builder->factorCapacity) {
+        while (builder->factorCount + length > builder->factorCapacity) {
+            builder->factorCapacity = builder->factorCapacity ? builder->factorCapacity * 2 : 32;
+        }
+        builder->symbols = (int *)realloc(builder->symbols, builder->factorCapacity * sizeof(int));
+        builder->powers = (int *)realloc(builder->powers, builder->factorCapacity * sizeof(int));
+    }
+    if (length > 0) {
+        memcpy(builder->symbols + builder->factorCount, symbols, length * sizeof(int));
+        memcpy(builder->powers + builder->factorCount, powers, length * sizeof(int));
+        builder->factorCount += length;
+    }
+    builder->coefficients[builder->count] = coefficient;
+    builder->offsets[++builder->count] = builder->factorCount;
+    builder->table[slot] = builder->count;
+    if (2 * builder->count > builder->tableSize) {
+        growTable(builder);
+    }
+}
+
+static Polynomial *builderFinish(PolyBuilder *builder)
+/*the polynomial in the expression arena without the terms that cancelled, NULL if the builder failed*/
+{
+    Polynomial *poly = NULL;
+    if (!builder->failed) {
+        Arena *arena = expressionArena();
+        poly = (Polynomial *)arenaAlloc(arena, sizeof(Polynomial));
+        poly->coefficients = (long long *)arenaAlloc(arena, (builder->count + 1) * sizeof(long long));
+        poly->offsets = (int *)arenaAlloc(arena, (builder->count + 1) * sizeof(int));
+        poly->symbols = (int *)arenaAlloc(arena, (builder->factorCount + 1) * sizeof(int));
+        poly->powers = (int *)arenaAlloc(arena, (builder->factorCount + 1) * sizeof(int));
+        poly->count = 0;
+        poly->offsets[0] = 0;
+        int factors = 0;
+        for (int term = 0; term < builder->count; term++) {
+            if (builder->coefficients[term] == 0) {
+                continue;
+            }
+            int start = builder->offsets[term], length = builder->offsets[term + 1] - start;
+            if (length > 0) {
+                memcpy(poly->symbols + factors, builder->symbols + start, length * sizeof(int));
+                memcpy(poly->powers + factors, builder->powers + start, length * sizeof(int));
+                factors += length;
+            }
+            poly->coefficients[poly->count] = builder->coefficients[term];
+            poly->offsets[++poly->count] = factors;
+        }
+    }
+    builderFree(builder);
+    return poly;
+}
+
+static void addScaled(PolyBuilder *builder, Polynomial *poly, long long scale)
+{
+    for (int term = 0; term < poly->count && !builder->failed; term++) {
+        long long coefficient;
+        if (!multiplyChecked(poly->coefficients[term], scale, &coefficient)) {
+            builder->failed = true;
+            return;
+        }
+        int start = poly->offsets[term];
+        builderAdd(builder, coefficient, poly->symbols + start, poly->powers + start, poly->offsets[term + 1] - start);
+    }
+}
+
+static Polynomial *multiply(Polynomial *a, Polynomial *b)
+{
+    PolyBuilder builder;
+    builderInit(&builder);
+    int longest = 0;
+    for (int i = 0; i < a->count; i++) {
+        longest = a->offsets[i + 1] - a->offsets[i] > longest ? a->offsets[i + 1] - a->offsets[i] : longest;
+    }
+    for (int j = 0; j < b->count; j++) {
+        longest = b->offsets[j + 1] - b->offsets[j] > longest ? b->offsets[j + 1] - b->offsets[j] : longest;
+    }
+    int *symbols = (int *)malloc((2 * longest + 1) * sizeof(int));
+    int *powers = (int *)malloc((2 * longest + 1) * sizeof(int));
+    for (int i = 0; i < a->count && !builder.failed; i++) {
+        for (int j = 0; j < b->count && !builder.failed; j++) {
+            long long coefficient;
+            if (!multiplyChecked(a->coefficients[i], b->coefficients[j], &coefficient)) {
+                builder.failed = true;
+                break;
+            }
+            int p = a->offsets[i], q = b->offsets[j], length = 0;
+            while (p < a->offsets[i + 1] || q < b->offsets[j + 1])
+            /*merge the two factor lists, both are sorted by symbol id*/
+            {
+                if (q == b->offsets[j + 1] || (p < a->offsets[i + 1] && a->symbols[p] < b->symbols[q])) {
+                    symbols[length] = a->symbols[p];
+                    powers[length++] = a->powers[p++];
+                }
+                else if (p == a->offsets[i + 1] || b->symbols[q] < a->symbols[p]) {
+                    symbols[length] = b->symbols[q];
+                    powers[length++] = b->powers[q++];
+                }
+                else {
+                    if ((long long)a->powers[p] + b->powers[q] > INT_MAX) {
+                        builder.failed = true;
+                    }
+                    symbols[length] = a->symbols[p];
+                    powers[length++] = a->powers[p++] + b->powers[q++];
+                }
+            }
+            builderAdd(&builder, coefficient, symbols, powers, length);
+        }
+    }
+    free(symbols);
+    free(powers);
+    return builderFinish(&builder);
+}
+
+static Polynomial *constantPolynomial(long long value)
+{
+    PolyBuilder builder;
+    int none = 0;
+    builderInit(&builder);
+    builderAdd(&builder, value, &none, &none, 0);
+    return builderFinish(&builder);
+}
+
+static Polynomial *power(Polynomial *base, int exponent)
+/*base ^ exponent by repeated squaring*/
+{
+    Polynomial *result = constantPolynomial(1);
+    while (exponent > 0 && result != NULL && base != NULL) {
+        if (exponent & 1) {
+            result = multiply(result, base);
+        }
+        exponent >>= 1;
+        if (exponent > 0) {
+            base = multiply(base, base);
+        }
+    }
+    return base == NULL ? NULL : result;
+}
+
+static bool isSumNode(Node *node)
+/*the nodes whose polynomial is a signed sum of the polynomials below them*/
+{
+    return (node->type == TOKEN_IS_OPERATOR && (node->operator == '+' || node->operator == '-'))
+        || (node->type == TOKEN_IS_FUNCTION && node->operator == '-');
+}
+
+static bool isPolynomialNode(Node *node)
+{
+    if (node->type == TOKEN_IS_NUM || node->type == TOKEN_IS_VAR || isSumNode(node)) {
+        return true;
+    }
+    if (node->type != TOKEN_IS_OPERATOR) {
+        return false;
+    }
+    return node->operator == '*' || (node->operator == '^' && node->Right->type == TOKEN_IS_NUM);
+    /*a division, a logarithm or a power with a variable exponent is not a polynomial*/
+    /*nor is a negative exponent, numbers are never negative, a negative constant is the negation of one*/
+}
+
+PolynomialSet *beginPolynomials(void)
+{
+    Arena *arena = expressionArena();
+    PolynomialSet *set = (PolynomialSet *)arenaAlloc(arena, sizeof(PolynomialSet));
+    set->limit = nodeStoreSize();
+    set->polys = (Polynomial **)arenaCalloc(arena, set->limit, sizeof(Polynomial *));
+    set->state = (unsigned char *)arenaCalloc(arena, set->limit, 1);
+    set->declined = (unsigned char *)arenaCalloc(arena, set->limit, 1);
+    PackedNode *packed = currentNodeStore()->packed;
+    for (int id = 0; id < set->limit; id++)
+    /*one sweep children first marks the nodes with a division, a logarithm or a variable exponent anywhere below*/
+    {
+        char type = PACKED_TYPE(packed[id].tag), operation = PACKED_OPERATOR(packed[id].tag);
+        bool shaped = type == TOKEN_IS_NUM || type == TOKEN_IS_VAR
+            || (type == TOKEN_IS_FUNCTION && operation == '-')
+            || (type == TOKEN_IS_OPERATOR && (operation == '+' || operation == '-' || operation == '*'))
+            || (type == TOKEN_IS_OPERATOR && operation == '^' && PACKED_TYPE(packed[packed[id].right].tag) == TOKEN_IS_NUM);
+        if (!shaped || (packed[id].left >= 0 && set->state[packed[id].left] == 2)
+            || (packed[id].right >= 0 && set->state[packed[id].right] == 2)) {
+            set->state[id] = 2;
+        }
+    }
+    int count = symbolCount();
+    int *order = (int *)malloc((count + 1) * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    qsort(order, count, sizeof(int), compareSymbols);
+    set->ranks = (int *)arenaAlloc(arena, (count + 1) * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        set->ranks[order[i]] = i;
+    }
+    free(order);
+    return set;
+}
+
+static bool walkSum(PolynomialSet *set, Node *sum, PolyBuilder *builder, Node ***pending, int *pendingTop, int *pendingCapacity)
+/*go through the sum down to the nodes that are not sums, pushing those without a polynomial onto pending*/
+/*with a builder, add their polynomials instead, return false if one of them is not a polynomial*/
+{
+    int capacity = 64, top = 0;
+    Node **stack = (Node **)malloc(capacity * sizeof(Node *));
+    long long *signs = (long long *)malloc(capacity * sizeof(long long));
+    long walked = 0;
+    bool valid = true;
+    stack[top] = sum;
+    signs[top++] = 1;
+    while (top > 0 && valid) {
+        Node *node = stack[--top];
+        long long sign = signs[top];
+        if (++walked > POLY_WALK_MAX) {
+            valid = false;
+            break;
+        }
+        if (node != sum && node->id < set->limit && set->state[node->id] != 0) {
+            if (set->state[node->id] == 2) {
+                valid = false;
+            }
+            else if (builder != NULL) {
+                addScaled(builder, set->polys[node->id], sign);
+            }
+            continue;
+            /*a piece that is worked out already, sum or not*/
+        }
+        if (!isPolynomialNode(node)) {
+            valid = false;
+        }
+        else if (isSumNode(node)) {
+            if (top + 2 > capacity) {
+                capacity *= 2;
+                stack = (Node **)realloc(stack, capacity * sizeof(Node *));
+                signs = (long long *)realloc(signs, capacity * sizeof(long long));
+            }
+            if (node->Right != NULL) {
+                stack[top] = node->Right;
+                signs[top++] = node->operator == '-' ? -sign : sign;
+            }
+            stack[top] = node->Left;
+            signs[top++] = node->type == TOKEN_IS_FUNCTION ? -sign : sign;
+        }
+        else if (builder == NULL) {
+            if (*pendingTop == *pendingCapacity) {
+                *pendingCapacity *= 2;
+                *pending = (Node **)realloc(*pending, *pendingCapacity * sizeof(Node *));
+            }
+            (*pending)[(*pendingTop)++] = node;
+            /*a product, a power or a leaf, worked out before the sum*/
+        }
+    }
+    free(stack);
+    free(signs);
+    return valid;
+}
+
+static Polynomial *leafPolynomial(Node *node)
+{
+    if (node->type == TOKEN_IS_NUM) {
+        return constantPolynomial(node->number);
+    }
+    PolyBuilder builder;
+    builderInit(&builder);
+    int one = 1;
+    builderAdd(&builder, 1, &node->symbol, &one, 1);
+    return builderFinish(&builder);
+}
+
+static Polynomial *polynomialOf(PolynomialSet *set, Node *root)
+/*the polynomial of the node, worked out bottom-up with an explicit stack, NULL if it is not one*/
+{
+    if (root->id >= set->limit) {
+        return NULL;
+    }
+    int capacity = 64, top = 0;
+    Node **stack = (Node **)malloc(capacity * sizeof(Node *));
+    stack[top++] = root;
+    while (top > 0) {
+        Node *node = stack[top - 1];
+        if (set->state[node->id] != 0) {
+            top--;
+            continue;
+        }
+        Polynomial *poly = NULL;
+        if (!isPolynomialNode(node)) {
+            poly = NULL;
+        }
+        else if (node->type == TOKEN_IS_NUM || node->type == TOKEN_IS_VAR) {
+            poly = leafPolynomial(node);
+        }
+        else if (isSumNode(node)) {
+            int before = top;
+            if (!walkSum(set, node, NULL, &stack, &top, &capacity)) {
+                top = before;
+            }
+            else if (top > before) {
+                continue;
+                /*the products under the sum come first*/
+            }
+            else {
+                PolyBuilder builder;
+                builderInit(&builder);
+                walkSum(set, node, &builder, &stack, &top, &capacity);
+                poly = builderFinish(&builder);
+            }
+        }
+        else {
+            Node *left = node->Left, *right = node->operator == '*' ? node->Right : NULL;
+            if (set->state[left->id] == 0 || (right != NULL && set->state[right->id] == 0)) {
+                if (top + 2 > capacity) {
+                    capacity *= 2;
+                    stack = (Node **)realloc(stack, capacity * sizeof(Node *));
+                }
+                if (right != NULL && set->state[right->id] == 0) {
+                    stack[top++] = right;
+                }
+                if (set->state[left->id] == 0) {
+                    stack[top++] = left;
+                }
+                continue;
+            }
+            Polynomial *a = set->polys[left->id];
+            Polynomial *b = right != NULL ? set->polys[right->id] : NULL;
+            if (a != NULL && node->operator == '^') {
+                poly = power(a, node->Right->number);
+            }
+            else if (a != NULL && b != NULL) {
+                poly = multiply(a, b);
+            }
+        }
+        set->polys[node->id] = poly;
+        set->state[node->id] = poly != NULL ? 1 : 2;
+        top--;
+    }
+    free(stack);
+    return set->polys[root->id];
+}
+
+static int compareTerms(const void *a, const void *b)
+/*the canonical order of the terms: by variable slot, then higher degree first, then by the exponents in the order of the names*/
+{
+    const int *x = *(int *const *)a, *y = *(int *const *)b;
+    /*a term is its slot, its degree, its coefficient index, its number of factors and then its rank and power pairs*/
+    if (x[0] != y[0]) {
+        return x[0] < y[0] ? -1 : 1;
+    }
+    if (x[1] != y[1]) {
+        return x[1] > y[1] ? -1 : 1;
+    }
+    for (int i = 0; i < x[3] && i < y[3]; i++) {
+        if (x[4 + 2 * i] != y[4 + 2 * i]) {
+            return x[4 + 2 * i] < y[4 + 2 * i] ? -1 : 1;
+            /*the term that has the earlier variable comes first*/
+        }
+        if (x[5 + 2 * i] != y[5 + 2 * i]) {
+            return x[5 + 2 * i] > y[5 + 2 * i] ? -1 : 1;
+        }
+    }
+    return x[3] > y[3] ? -1 : x[3] < y[3] ? 1 : 0;
+}
+
+static Node *termNode(int *term, int *symbolOfRank, long long coefficient)
+/*|coefficient| * x ^ a * y ^ b ..., with the variables in the order of their names*/
+{
+    Node *monomial = NULL;
+    for (int i = 0; i < term[3]; i++) {
+        Node *factor = createNode(TOKEN_IS_VAR, '\0', 0, symbolOfRank[term[4 + 2 * i]]);
+        if (term[5 + 2 * i] > 1) {
+            factor = internNode(TOKEN_IS_OPERATOR, '^', 0, -1, factor, createNode(TOKEN_IS_NUM, '\0', term[5 + 2 * i], -1));
+        }
+        monomial = monomial == NULL ? factor : internNode(TOKEN_IS_OPERATOR, '*', 0, -1, monomial, factor);
+    }
+    long long magnitude = coefficient < 0 ? -coefficient : coefficient;
+    if (monomial == NULL) {
+        return createNode(TOKEN_IS_NUM, '\0', (int)magnitude, -1);
+    }
+    if (magnitude == 1) {
+        return monomial;
+    }
+    return internNode(TOKEN_IS_OPERATOR, '*', 0, -1, createNode(TOKEN_IS_NUM, '\0', (int)magnitude, -1), monomial);
+}
+
+static int decline(PolynomialSet *set, Node *sum)
+/*mark the sums the sum is made of, so the tape doesn't expand every shorter chain of the same terms again*/
+{
+    if (!isSumNode(sum)) {
+        return -1;
+    }
+    int capacity = 64, top = 0;
+    Node **stack = (Node **)malloc(capacity * sizeof(Node *));
+    stack[top++] = sum;
+    while (top > 0) {
+        Node *node = stack[--top];
+        if (node->id >= set->limit || set->declined[node->id] || !isSumNode(node)) {
+            continue;
+        }
+        set->declined[node->id] = 1;
+        if (top + 2 > capacity) {
+            capacity *= 2;
+            stack = (Node **)realloc(stack, capacity * sizeof(Node *));
+        }
+        if (node->Right != NULL) {
+            stack[top++] = node->Right;
+        }
+        stack[top++] = node->Left;
+    }
+    free(stack);
+    return -1;
+}
+
+static int termSize(int *term, long long coefficient)
+/*the nodes of the term as termNode() makes it*/
+{
+    int size = term[3] > 0 ? term[3] - 1 : 1;
+    for (int i = 0; i < term[3]; i++) {
+        size += term[5 + 2 * i] > 1 ? 3 : 1;
+    }
+    return size + (term[3] > 0 && coefficient != 1 && coefficient != -1 ? 2 : 0);
+}
+
+int polynomialGradient(PolynomialSet *set, Node *node, int *position, Node **gradient, int *slots)
+{
+    if (node->type == TOKEN_IS_NUM || node->type == TOKEN_IS_VAR || !isPolynomialNode(node)) {
+        return -1;
+        /*the leaves are as quick to differentiate the usual way*/
+    }
+    if (node->id >= set->limit || set->state[node->id] == 2 || set->declined[node->id]) {
+        return -1;
+    }
+    Polynomial *poly = polynomialOf(set, node);
+    if (poly == NULL) {
+        return decline(set, node);
+    }
+    long expanded = 0, poolSize = 0;
+    int count = 0;
+    for (int term = 0; term < poly->count; term++) {
+        int length = poly->offsets[term + 1] - poly->offsets[term];
+        expanded += 1 + length;
+        for (int f = poly->offsets[term]; f < poly->offsets[term + 1]; f++) {
+            long long coefficient;
+            if (position[poly->symbols[f]] < 0) {
+                continue;
+            }
+            if (!multiplyChecked(poly->coefficients[term], poly->powers[f], &coefficient)
+                || coefficient > INT_MAX || coefficient < -(long long)INT_MAX) {
+                return decline(set, node);
+                /*the node store only has int numbers*/
+            }
+            poolSize += 4 + 2 * length;
+            count++;
+        }
+    }
+    if (expanded > (long)node->size + 8) {
+        return decline(set, node);
+        /*the expansion is bigger than the tree, like (x + y) ^ 3 * (x - z), the tree is differentiated as it is*/
+    }
+
+    int symbolTotal = symbolCount();
+    int *symbolOfRank = (int *)malloc((symbolTotal + 1) * sizeof(int));
+    for (int s = 0; s < symbolTotal; s++) {
+        symbolOfRank[set->ranks[s]] = s;
+    }
+    int *pool = (int *)malloc((poolSize + 1) * sizeof(int));
+    int **terms = (int **)malloc((count + 1) * sizeof(int *));
+    long long *coefficients = (long long *)malloc((count + 1) * sizeof(long long));
+    long used = 0;
+    count = 0;
+    for (int term = 0; term < poly->count; term++) {
+        int start = poly->offsets[term], length = poly->offsets[term + 1] - start;
+        for (int f = start; f < start + length; f++) {
+            int slot = position[poly->symbols[f]];
+            if (slot < 0) {
+                continue;
+            }
+            int *entry = pool + used;
+            int degree = 0, factors = 0;
+            for (int g = start; g < start + length; g++) {
+                int exponent = poly->powers[g] - (g == f ? 1 : 0);
+                /*the exponent shift of the variable the derivative is taken by*/
+                if (exponent == 0) {
+                    continue;
+                }
+                int rank = set->ranks[poly->symbols[g]], at = factors++;
+                while (at > 0 && entry[4 + 2 * (at - 1)] > rank)
+                /*insertion sort by rank, a monomial has few variables*/
+                {
+                    entry[4 + 2 * at] = entry[4 + 2 * (at - 1)];
+                    entry[5 + 2 * at] = entry[5 + 2 * (at - 1)];
+                    at--;
+                }
+                entry[4 + 2 * at] = rank;
+                entry[5 + 2 * at] = exponent;
+                degree += exponent;
+            }
+            entry[0] = slot;
+            entry[1] = degree;
+            entry[2] = count;
+            entry[3] = factors;
+            used += 4 + 2 * factors;
+            coefficients[count] = poly->coefficients[term] * poly->powers[f];
+            terms[count++] = entry;
+        }
+    }
+    qsort(terms, count, sizeof(int *), compareTerms);
+    bool smaller = true;
+    for (int i = 0, size = 0; i < count && smaller; i++)
+    /*the derivative by one variable would be about as big as the tree the usual way, the expansion must not be bigger*/
+    {
+        size += termSize(terms[i], coefficients[terms[i][2]]) + 1;
+        if (i + 1 == count || terms[i + 1][0] != terms[i][0]) {
+            smaller = size <= node->size + 2;
+            size = 0;
+        }
+    }
+    if (!smaller) {
+        free(coefficients);
+        free(terms);
+        free(pool);
+        free(symbolOfRank);
+        return decline(set, node);
+    }
+
+    int found = 0;
+    for (int i = 0; i < count; i++)
+    /*every derivative is a chain of its terms, in the canonical order*/
+    {
+        int *entry = terms[i];
+        long long coefficient = coefficients[entry[2]];
+        Node *term = termNode(entry, symbolOfRank, coefficient);
+        int slot = entry[0];
+        if (found == 0 || slots[found - 1] != slot) {
+            slots[found++] = slot;
+            gradient[slot] = coefficient < 0 ? internNode(TOKEN_IS_FUNCTION, '-', 0, -1, term, NULL) : term;
+        }
+        else {
+            gradient[slot] = internNode(TOKEN_IS_OPERATOR, coefficient < 0 ? '-' : '+', 0, -1, gradient[slot], term);
+        }
+    }
+    free(coefficients);
+    free(terms);
+    free(pool);
+    free(symbolOfRank);
+    return found;
+}
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include "header.h"
+
+/*necessary header files included*/
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE CondVar;
+typedef HANDLE Thread;
+#define mutexInit(m) InitializeCriticalSection(m)
+#define mutexDestroy(m) DeleteCriticalSection(m)
+#define mutexLock(m) EnterCriticalSection(m)
+#define mutexUnlock(m) LeaveCriticalSection(m)
+#define condInit(c) InitializeConditionVariable(c)
+#define condDestroy(c) ((void)0)
+#define condWait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define condBroadcast(c) WakeAllConditionVariable(c)
+#else
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t CondVar;
+typedef pthread_t Thread;
+#define mutexInit(m) pthread_mutex_init(m, NULL)
+#define mutexDestroy(m) pthread_mutex_destroy(m)
+#define mutexLock(m) pthread_mutex_lock(m)
+#define mutexUnlock(m) pthread_mutex_unlock(m)
+#define condInit(c) pthread_cond_init(c, NULL)
+#define condDestroy(c) pthread_cond_destroy(c)
+#define condWait(c, m) pthread_cond_wait(c, m)
+#define condBroadcast(c) pthread_cond_broadcast(c)
+#endif
+/*the few thread primitives the pool needs, on both Windows and POSIX*/
+
+typedef struct Task {
+    TaskFunction run;
+    /*the function of the task*/
+    void *arg;
+    /*its argument*/
+    TaskGroup *group;
+    /*the group that is told when the task is finished*/
+} Task;
+
+typedef struct WorkQueue {
+    Task *tasks;
+    /*circular buffer of tasks*/
+    int head, count, capacity;
+    /*index of the oldest task, number of tasks and allocated slots*/
+    Mutex lock;
+    /*the owner and the thieves take turns on the queue*/
+} WorkQueue;
+/*the owner pushes and pops at the tail (newest first), thieves steal from the head (oldest first)*/
+
+typedef struct Worker {
+    ThreadPool *pool;
+    int index;
+    Thread thread;
+} Worker;
+
+struct ThreadPool {
+    int workerCount;
+    /*number of worker threads*/
+    Worker *workers;
+    WorkQueue *queues;
+    /*one queue per worker, and one more for the threads outside the pool*/
+    Mutex lock;
+    /*protects the fields below and the pending counts of the groups*/
+    CondVar changed;
+    /*broadcast whenever a task is queued or a group becomes empty*/
+    int queued;
+    /*number of tasks waiting in all the queues*/
+    bool stopping;
+    /*set when the pool is destroyed*/
+};
+
+static THREAD_LOCAL ThreadPool *currentPool = NULL;
+static THREAD_LOCAL int currentWorker = -1;
+/*which pool and worker the running thread belongs to, -1 outside the pool*/
+
+static void pushTask(WorkQueue *queue, Task task)
+{
+    mutexLock(&queue->lock);
+    if (queue->count == queue->capacity) {
+        int newCapacity = queue->capacity ? queue->capacity * 2 : 64;
+        Task *tasks = (Task *)malloc(newCapacity * sizeof(Task));
+        for (int i = 0; i < queue->count; i++) {
+            tasks[i] = queue->tasks[(queue->head + i) % queue->capacity];
+            /*unroll the circular buffer into the new one*/
+        }
+        free(queue->tasks);
+        queue->tasks = tasks;
+        queue->head = 0;
+        queue->capacity = newCapacity;
+    }
+    queue->tasks[(queue->head + queue->count) % queue->capacity] = task;
+    queue->count++;
+    mutexUnlock(&queue->lock);
+}
+
+static bool popTask(WorkQueue *queue, Task *task, bool fromTail, TaskGroup *group)
+/*take the newest (fromTail) or the oldest task, only of the group unless group is NULL*/
+{
+    bool found = false;
+    mutexLock(&queue->lock);
+    for (int i = 0; i < queue->count && !found; i++) {
+        int position = fromTail ? queue->count - 1 - i : i;
+        int slot = (queue->head + position) % queue->capacity;
+        if (group != NULL && queue->tasks[slot].group != group) {
+            continue;
+        }
+        *task = queue->tasks[slot];
+        if (position == 0) {
+            queue->head = (queue->head + 1) % queue->capacity;
+            /*the oldest task is taken, so only the head moves*/
+        }
+        else {
+            for (int j = position; j < queue->count - 1; j++) {
+                queue->tasks[(queue->head + j) % queue->capacity] = queue->tasks[(queue->head + j + 1) % queue->capacity];
+                /*close the gap, which is a no-op when the newest task is taken*/
+            }
+        }
+        queue->count--;
+        found = true;
+    }
+    mutexUnlock(&queue->lock);
+    return found;
+}
+
+static bool takeTask(ThreadPool *pool, Task *task, TaskGroup *group)
+/*take from the own queue first, then from the outside queue, then steal from the other workers*/
+{
+    int queueCount = pool->workerCount + 1;
+    int own = (currentPool == pool && currentWorker >= 0) ? currentWorker : pool->workerCount;
+    bool found = popTask(&pool->queues[own], task, true, group);
+    if (!found && own != pool->workerCount) {
+        found = popTask(&pool->queues[pool->workerCount], task, false, group);
+        /*then the oldest task submitted from outside the pool*/
+    }
+    for (int i = 1; i < queueCount && !found; i++) {
+        int victim = (own + i) % queueCount;
+        if (victim != pool->workerCount) {
+            found = popTask(&pool->queues[victim], task, false, group);
+        }
+    }
+    if (found) {
+        mutexLock(&pool->lock);
+        pool->queued--;
+        mutexUnlock(&pool->lock);
+    }
+    return found;
+}
+
+static void runTask(ThreadPool *pool, Task *task)
+{
+    task->run(task->arg);
+    mutexLock(&pool->lock);
+    task->group->pending--;
+    if (task->group->pending == 0) {
+        condBroadcast(&pool->changed);
+        /*somebody may be waiting for this group*/
+    }
+    mutexUnlock(&pool->lock);
+}
+
+#ifdef _WIN32
+static unsigned __stdcall workerMain(void *arg)
+#else
+static void *workerMain(void *arg)
+#endif
+{
+    Worker *worker = (Worker *)arg;
+    ThreadPool *pool = worker->pool;
+    currentPool = pool;
+    currentWorker = worker->index;
+    while (true) {
+        mutexLock(&pool->lock);
+        while (pool->queued == 0 && !pool->stopping) {
+            condWait(&pool->changed, &pool->lock);
+            /*sleep until there is something to do*/
+        }
+        bool stopping = pool->stopping && pool->queued == 0;
+        mutexUnlock(&pool->lock);
+        if (stopping) {
+            break;
+        }
+        Task task;
+        if (takeTask(pool, &task, NULL)) {
+            runTask(pool, &task);
+        }
+    }
+    releaseThreadMemory();
+    /*the arena of this worker goes back to the system with the thread*/
+    return 0;
+}
+
+ThreadPool *createThreadPool(int workerCount)
+{
+    if (workerCount <= 0) {
+        workerCount = cpuCount();
+    }
+    ThreadPool *pool = (ThreadPool *)calloc(1, sizeof(ThreadPool));
+    pool->workerCount = workerCount;
+    pool->workers = (Worker *)calloc(workerCount, sizeof(Worker));
+    pool->queues = (WorkQueue *)calloc(workerCount + 1, sizeof(WorkQueue));
+    for (int i = 0; i <= workerCount; i++) {
+        mutexInit(&pool->queues[i].lock);
+    }
+    mutexInit(&pool->lock);
+    condInit(&pool->changed);
+    for (int i = 0; i < workerCount; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+#ifdef _WIN32
+        pool->workers[i].thread = (HANDLE)_beginthreadex(NULL, 0, workerMain, &pool->workers[i], 0, NULL);
+#else
+        pthread_create(&pool->workers[i].thread, NULL, workerMain, &pool->workers[i]);
+#endif
+    }
+    return pool;
+}
+
+void destroyThreadPool(ThreadPool *pool)
+{
+    mutexLock(&pool->lock);
+    pool->stopping = true;
+    condBroadcast(&pool->changed);
+    mutexUnlock(&pool->lock);
+    for (int i = 0; i < pool->workerCount; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(pool->workers[i].thread, INFINITE);
+        CloseHandle(pool->workers[i].thread);
+#else
+        pthread_join(pool->workers[i].thread, NULL);
+#endif
+    }
+    for (int i = 0; i <= pool->workerCount; i++) {
+        free(pool->queues[i].tasks);
+        mutexDestroy(&pool->queues[i].lock);
+    }
+    mutexDestroy(&pool->lock);
+    condDestroy(&pool->changed);
+    free(pool->queues);
+    free(pool->workers);
+    free(pool);
+}
+
+int poolWorkerCount(ThreadPool *pool)
+{
+    return pool->workerCount;
+}
+
+void poolSubmit(ThreadPool *pool, TaskGroup *group, TaskFunction run, void *arg)
+{
+    Task task = {run, arg, group};
+    mutexLock(&pool->lock);
+    group->pending++;
+    int queue = pool->workerCount;
+    /*tasks from outside go onto the shared queue and are taken oldest first, so they run in order*/
+    if (currentPool == pool && currentWorker >= 0) {
+        queue = currentWorker;
+        /*a task spawned by a worker goes onto its own queue, where it is likely to stay hot*/
+    }
+    pushTask(&pool->queues[queue], task);
+    pool->queued++;
+    /*pushed and counted under the pool lock, so nobody sees the count fall below zero*/
+    condBroadcast(&pool->changed);
+    mutexUnlock(&pool->lock);
+}
+
+void poolWait(ThreadPool *pool, TaskGroup *group)
+{
+    while (true) {
+        mutexLock(&pool->lock);
+        while (group->pending > 0 && pool->queued == 0) {
+            condWait(&pool->changed, &pool->lock);
+        }
+        bool done = group->pending == 0;
+        mutexUnlock(&pool->lock);
+        if (done) {
+            return;
+        }
+        Task task;
+        if (takeTask(pool, &task, group)) {
+            runTask(pool, &task);
+            /*the waiting thread helps instead of blocking, but only with its own group*/
+            /*a task of another group could release the thread-local expression that is still being waited on*/
+        }
+        else {
+            mutexLock(&pool->lock);
+            if (group->pending > 0) {
+                condWait(&pool->changed, &pool->lock);
+                /*the rest of the group is running on other threads*/
+            }
+            mutexUnlock(&pool->lock);
+        }
+    }
+}
+
+int cpuCount(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
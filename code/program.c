@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "header.h"
+
+/*necessary header files included*/
+
+Program *compileProgram(Node **roots, int count)
+{
+    Program *program = (Program *)calloc(1, sizeof(Program));
+    VarList list = {NULL, 0, NULL};
+    collectVariables(roots, count, &list);
+    /*a variable of several roots is one input*/
+    if (list.count > 1) {
+        qsort(list.symbols, list.count, sizeof(int), compareSymbols);
+        /*the inputs in the same order as the gradient is printed*/
+    }
+    int symbols = symbolCount();
+    int *position = (int *)malloc((symbols + 1) * sizeof(int));
+    for (int s = 0; s < symbols; s++) {
+        position[s] = -1;
+    }
+    program->inputCount = list.count;
+    program->names = (char **)malloc((list.count + 1) * sizeof(char *));
+    for (int i = 0; i < list.count; i++) {
+        size_t length = symbolLength(list.symbols[i]);
+        program->names[i] = (char *)malloc(length + 1);
+        memcpy(program->names[i], symbolName(list.symbols[i]), length + 1);
+        position[list.symbols[i]] = i;
+    }
+
+    GradTape tape = {NULL, 0, 0, NULL, 0};
+    program->outputCount = count;
+    program->outputs = (int *)malloc((count + 1) * sizeof(int));
+    recordTape(roots, count, &tape, program->outputs);
+    /*the tape records every distinct node once in topological order, which is the order of the instructions*/
+    program->count = tape.count;
+    program->code = (Instruction *)malloc((tape.count + 1) * sizeof(Instruction));
+    program->constants = (double *)malloc((tape.count + 1) * sizeof(double));
+    unsigned long long *depends = currentNodeStore()->depends;
+    for (int i = 0; i < tape.count; i++) {
+        TapeEntry *entry = &tape.entries[i];
+        Node *node = entry->node;
+        Instruction *op = &program->code[i];
+        op->left = entry->left;
+        op->right = entry->right;
+        op->needs = 0;
+        if (node->type == TOKEN_IS_NUM) {
+            op->operation = 'N';
+            op->left = program->constantCount;
+            program->constants[program->constantCount++] = node->number;
+            /*the store has every number once, so no constant is loaded twice*/
+        }
+        else if (node->type == TOKEN_IS_VAR) {
+            op->operation = 'V';
+            op->left = position[node->symbol];
+        }
+        else {
+            op->operation = node->type == TOKEN_IS_FUNCTION ? (node->operator == '-' ? '~' : 'l') : node->operator;
+            op->needs = (depends[node->Left->id] != 0 ? 1 : 0) | (node->Right != NULL && depends[node->Right->id] != 0 ? 2 : 0);
+        }
+    }
+    freeTape(&tape);
+    free(position);
+    return program;
+}
+
+void freeProgram(Program *program)
+{
+    if (program == NULL) {
+        return;
+    }
+    for (int i = 0; i < program->inputCount; i++) {
+        free(program->names[i]);
+    }
+    free(program->names);
+    free(program->outputs);
+    free(program->constants);
+    free(program->code);
+    free(program);
+}
+
+int programInput(Program *program, char *name, size_t length)
+{
+    for (int i = 0; i < program->inputCount; i++) {
+        if (strlen(program->names[i]) == length && memcmp(program->names[i], name, length) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void forward(const Program *program, const double *inputs, double *registers, int last)
+/*the forward sweep over the instructions up to last, one switch per node and no branch on the structure*/
+{
+    const Instruction *code = program->code;
+    const double *constants = program->constants;
+    for (int i = 0; i <= last; i++) {
+        const Instruction *op = &code[i];
+        double value;
+        switch (op->operation) {
+            case 'N':
+                value = constants[op->left];
+                break;
+            case 'V':
+                value = inputs[op->left];
+                break;
+            case '+':
+                value = registers[op->left] + registers[op->right];
+                break;
+            case '-':
+                value = registers[op->left] - registers[op->right];
+                break;
+            case '*':
+                value = registers[op->left] * registers[op->right];
+                break;
+            case '/':
+                value = registers[op->left] / registers[op->right];
+                break;
+            case '^':
+                value = pow(registers[op->left], registers[op->right]);
+                break;
+            case 'l':
+                value = log(registers[op->left]);
+                break;
+            default:
+                value = -registers[op->left];
+                break;
+        }
+        registers[i] = value;
+    }
+}
+
+void evaluateProgram(const Program *program, const double *inputs, double *registers)
+{
+    forward(program, inputs, registers, program->count - 1);
+}
+
+double gradientProgram(const Program *program, int output, const double *inputs, double *registers, double *adjoints, double *gradient)
+{
+    int last = program->outputs[output];
+    forward(program, inputs, registers, last);
+    /*the instructions after the output don't feed it*/
+    memset(adjoints, 0, (last + 1) * sizeof(double));
+    memset(gradient, 0, program->inputCount * sizeof(double));
+    adjoints[last] = 1;
+    const Instruction *code = program->code;
+    for (int i = last; i >= 0; i--)
+    /*the same rules as backward(), on numbers instead of nodes*/
+    {
+        const Instruction *op = &code[i];
+        double adjoint = adjoints[i];
+        int left = op->left, right = op->right;
+        switch (op->operation) {
+            case 'V':
+                gradient[left] += adjoint;
+                break;
+            case '+':
+                if (op->needs & 1) adjoints[left] += adjoint;
+                if (op->needs & 2) adjoints[right] += adjoint;
+                break;
+            case '-':
+                if (op->needs & 1) adjoints[left] += adjoint;
+                if (op->needs & 2) adjoints[right] -= adjoint;
+                break;
+            case '*':
+                if (op->needs & 1) adjoints[left] += adjoint * registers[right];
+                if (op->needs & 2) adjoints[right] += adjoint * registers[left];
+                break;
+            case '/':
+                if (op->needs & 1) adjoints[left] += adjoint / registers[right];
+                if (op->needs & 2) adjoints[right] -= adjoint * registers[i] / registers[right];
+                /*d(a / b) / db = -(a / b) / b*/
+                break;
+            case '^':
+                if (op->needs & 1) adjoints[left] += adjoint * registers[right] * pow(registers[left], registers[right] - 1);
+                /*b * a ^ (b - 1) instead of a ^ b * b / a, which is no number at a = 0*/
+                if (op->needs & 2) adjoints[right] += adjoint * registers[i] * log(registers[left]);
+                break;
+            case 'l':
+                if (op->needs & 1) adjoints[left] += adjoint / registers[left];
+                break;
+            case '~':
+                if (op->needs & 1) adjoints[left] -= adjoint;
+                break;
+        }
+    }
+    return registers[last];
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include "header.h"
+
+/*necessary header files included*/
+
+Rope ropeZero = {1, "0", NULL, NULL};
+/*the text of a node that renders to nothing else*/
+
+Rope *ropeText(char *text, size_t length)
+{
+    Rope *rope = (Rope *)arenaAlloc(expressionArena(), sizeof(Rope));
+    rope->length = length;
+    rope->text = text;
+    /*the characters are not copied, the text has to live as long as the rope*/
+    rope->Left = rope->Right = NULL;
+    return rope;
+}
+
+Rope *ropeConcat(Rope *left, Rope *right)
+{
+    if (left->length == 0) {
+        return right;
+    }
+    if (right->length == 0) {
+        return left;
+    }
+    Rope *rope = (Rope *)arenaAlloc(expressionArena(), sizeof(Rope));
+    rope->length = left->length + right->length;
+    rope->text = NULL;
+    rope->Left = left;
+    rope->Right = right;
+    /*O(1), none of the characters are touched*/
+    return rope;
+}
+
+Rope *ropeBuild(char *fmt, ...)
+/*%r takes a Rope *, %c takes a char, everything else is literal text pointing into fmt*/
+{
+    va_list args;
+    va_start(args, fmt);
+    Rope *result = NULL;
+    char *start = fmt;
+    /*start of the literal run that has not been added yet*/
+    for (char *c = fmt; ; c++) {
+        if (*c != '\0' && !(c[0] == '%' && (c[1] == 'r' || c[1] == 'c'))) {
+            continue;
+        }
+        if (c > start) {
+            Rope *literal = ropeText(start, c - start);
+            result = result ? ropeConcat(result, literal) : literal;
+            /*the literal is used in place, format strings are string literals*/
+        }
+        if (*c == '\0') {
+            break;
+        }
+        Rope *piece;
+        if (c[1] == 'r') {
+            piece = va_arg(args, Rope *);
+        }
+        else {
+            char *text = (char *)arenaAlloc(expressionArena(), 1);
+            text[0] = (char)va_arg(args, int);
+            piece = ropeText(text, 1);
+        }
+        result = result ? ropeConcat(result, piece) : piece;
+        c++;
+        start = c + 1;
+    }
+    va_end(args);
+    return result ? result : ropeText("", 0);
+}
+
+static void ropeVisit(Rope *rope, void (*emit)(char *text, size_t length, void *context), void *context)
+/*hand the leaves to emit from left to right, with an explicit stack so deep ropes don't overflow*/
+{
+    int capacity = 64, top = 0;
+    Rope **stack = (Rope **)malloc(capacity * sizeof(Rope *));
+    stack[top++] = rope;
+    while (top > 0) {
+        Rope *current = stack[--top];
+        if (current->text != NULL) {
+            emit(current->text, current->length, context);
+            continue;
+        }
+        if (top + 2 > capacity) {
+            capacity *= 2;
+            stack = (Rope **)realloc(stack, capacity * sizeof(Rope *));
+        }
+        stack[top++] = current->Right;
+        stack[top++] = current->Left;
+        /*the left half is popped first*/
+    }
+    free(stack);
+}
+
+static void emitToOutput(char *text, size_t length, void *context)
+{
+    outputText((OutputBuffer *)context, text, length);
+}
+
+void outputRope(OutputBuffer *out, Rope *rope)
+{
+    ropeVisit(rope, emitToOutput, out);
+}
+
+static void reserveOutput(OutputBuffer *out, size_t extra)
+/*make room for extra more bytes, doubling the buffer so appending is amortized O(1)*/
+{
+    if (out->length + extra <= out->capacity) {
+        return;
+    }
+    size_t newCapacity = out->capacity ? out->capacity * 2 : 256;
+    while (newCapacity < out->length + extra) {
+        newCapacity *= 2;
+    }
+    out->data = (char *)realloc(out->data, newCapacity);
+    out->capacity = newCapacity;
+}
+
+void outputText(OutputBuffer *out, char *text, size_t length)
+{
+    reserveOutput(out, length);
+    memcpy(out->data + out->length, text, length);
+    out->length += length;
+}
+
+void outputFormat(OutputBuffer *out, char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    char probe[FORMAT_PROBE_LEN];
+    int length = vsnprintf(probe, sizeof(probe), fmt, args);
+    va_end(args);
+    /*measure first, in the same way as formatExpr()*/
+    if (length < (int)sizeof(probe)) {
+        outputText(out, probe, length);
+        return;
+    }
+    reserveOutput(out, length + 1);
+    va_start(args, fmt);
+    vsnprintf(out->data + out->length, length + 1, fmt, args);
+    va_end(args);
+    out->length += length;
+}
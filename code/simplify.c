@@ -0,0 +1,512 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <string.h>
+#include "header.h"
+
+/*necessary header files included*/
+
+#define SIMPLIFY_MAX_DEPTH 32
+/*how deep the rules may rewrite the nodes they have just built, the rules only ever shrink a node so this is rarely reached*/
+
+static Node *rewrite(char op, Node *a, Node *b, int depth);
+
+static bool constantValue(Node *node, long long *value)
+/*whether the node is an integer constant, a number or the negation of one*/
+{
+    if (node->type == TOKEN_IS_NUM) {
+        *value = node->number;
+        return true;
+    }
+    if (node->type == TOKEN_IS_FUNCTION && node->operator == '-' && node->Left->type == TOKEN_IS_NUM) {
+        *value = -(long long)node->Left->number;
+        return true;
+    }
+    return false;
+}
+
+static bool isConstant(Node *node, long long value)
+{
+    long long actual;
+    return constantValue(node, &actual) && actual == value;
+}
+
+static Node *constantNode(long long value)
+/*a number, negative values are the negation of a number since the input has no negative literals, NULL if it does not fit*/
+{
+    if (value > INT_MAX || value < -(long long)INT_MAX) {
+        return NULL;
+    }
+    if (value >= 0) {
+        return createNode(TOKEN_IS_NUM, '\0', (int)value, -1);
+    }
+    return internNode(TOKEN_IS_FUNCTION, '-', 0, -1, createNode(TOKEN_IS_NUM, '\0', (int)-value, -1), NULL);
+}
+
+static Node *plainNode(char op, Node *a, Node *b) {
+    return internNode(TOKEN_IS_OPERATOR, op, 0, -1, a, b);
+}
+
+static Node *negate(Node *a, int depth)
+{
+    long long value;
+    Node *folded;
+    if (constantValue(a, &value) && (folded = constantNode(-value)) != NULL) {
+        return folded;
+        /*a constant whose negation does not fit is negated as a node*/
+    }
+    if (a->type == TOKEN_IS_FUNCTION && a->operator == '-') {
+        return a->Left;
+        /*-(-a) = a*/
+    }
+    if (a->type == TOKEN_IS_OPERATOR && a->operator == '-' && depth < SIMPLIFY_MAX_DEPTH) {
+        return rewrite('-', a->Right, a->Left, depth + 1);
+        /*-(a - b) = b - a*/
+    }
+    return internNode(TOKEN_IS_FUNCTION, '-', 0, -1, a, NULL);
+}
+
+static long long gcd(long long a, long long b)
+{
+    a = a < 0 ? -a : a;
+    b = b < 0 ? -b : b;
+    while (b != 0) {
+        long long rest = a % b;
+        a = b;
+        b = rest;
+    }
+    return a;
+}
+
+static Node *foldConstants(char op, long long a, long long b)
+/*the value of a op b for two constants, NULL if it is not an integer that fits (the expression is then kept)*/
+{
+    switch (op) {
+        case '+':
+            return constantNode(a + b);
+        case '-':
+            return constantNode(a - b);
+        case '*':
+            if (a != 0 && (b > LLONG_MAX / (a < 0 ? -a : a) || b < -LLONG_MAX / (a < 0 ? -a : a))) {
+                return NULL;
+            }
+            return constantNode(a * b);
+            /*the operands are ints, so only the range of the result has to be checked*/
+        case '/':
+            if (b == 0) {
+                return NULL;
+                /*a division by zero is left for whoever evaluates it*/
+            }
+            if (a % b == 0) {
+                return constantNode(a / b);
+            }
+            {
+                long long divisor = gcd(a, b);
+                if (b < 0) {
+                    divisor = -divisor;
+                }
+                if (divisor == 1) {
+                    return NULL;
+                    /*an irreducible fraction stays as it is*/
+                }
+                Node *numerator = constantNode(a / divisor), *denominator = constantNode(b / divisor);
+                if (numerator == NULL || denominator == NULL) {
+                    return NULL;
+                    /*a part that does not fit would leave the quotient without a child, the fraction is kept*/
+                }
+                return plainNode('/', numerator, denominator);
+            }
+        case '^':
+            if (b < 0) {
+                return NULL;
+            }
+            {
+                long long power = 1;
+                for (long long i = 0; i < b; i++) {
+                    if (power * a > INT_MAX || power * a < -(long long)INT_MAX) {
+                        return NULL;
+                    }
+                    power *= a;
+                    if (power == 0 || power == 1) {
+                        break;
+                        /*0 and 1 stay what they are, however big the exponent*/
+                    }
+                    if (power == -1) {
+                        power = (b - i - 1) % 2 == 0 ? -1 : 1;
+                        break;
+                    }
+                }
+                return constantNode(power);
+            }
+    }
+    return NULL;
+}
+
+static void splitTerm(Node *node, long long *coefficient, Node **base, bool *reciprocal)
+/*node = coefficient * base, or coefficient / base if reciprocal is set, with an integer coefficient that is 1 if there is none*/
+{
+    *coefficient = 1;
+    *base = node;
+    *reciprocal = false;
+    if (node->type == TOKEN_IS_FUNCTION && node->operator == '-') {
+        splitTerm(node->Left, coefficient, base, reciprocal);
+        *coefficient = -*coefficient;
+        /*the negation of a negation is folded away before, so this goes one level deep*/
+        return;
+    }
+    long long value;
+    if (node->type == TOKEN_IS_OPERATOR && (node->operator == '*' || node->operator == '/') && constantValue(node->Left, &value)) {
+        *coefficient = value;
+        *base = node->Right;
+        *reciprocal = node->operator == '/';
+        /*k / x is a multiple of 1 / x, so 5 / x - 7 / x is collected too*/
+    }
+}
+
+static Node *makeTerm(long long coefficient, Node *base, bool reciprocal, int depth)
+{
+    if (coefficient > INT_MAX || coefficient < -(long long)INT_MAX) {
+        return NULL;
+    }
+    if (coefficient == 0) {
+        return constantNode(0);
+    }
+    if (reciprocal) {
+        return rewrite('/', constantNode(coefficient), base, depth + 1);
+    }
+    if (coefficient == 1) {
+        return base;
+    }
+    if (coefficient == -1) {
+        return negate(base, depth + 1);
+    }
+    return rewrite('*', constantNode(coefficient), base, depth + 1);
+}
+
+static Node *mergeTerms(char op, Node *a, Node *b, int depth)
+/*a + b or a - b as one term if they are constants or multiples of the same base, NULL otherwise*/
+{
+    long long va, vb;
+    if (constantValue(a, &va) && constantValue(b, &vb)) {
+        return foldConstants(op, va, vb);
+    }
+    Node *baseA, *baseB;
+    bool reciprocalA, reciprocalB;
+    splitTerm(a, &va, &baseA, &reciprocalA);
+    splitTerm(b, &vb, &baseB, &reciprocalB);
+    if (baseA != baseB || reciprocalA != reciprocalB) {
+        return NULL;
+        /*the nodes are hash-consed, so equal bases are the same node*/
+    }
+    return makeTerm(op == '+' ? va + vb : va - vb, baseA, reciprocalA, depth);
+}
+
+static Node *rewriteSum(char op, Node *a, Node *b, int depth)
+/*a + b and a - b*/
+{
+    if (isConstant(b, 0)) {
+        return a;
+    }
+    if (isConstant(a, 0)) {
+        return op == '+' ? b : negate(b, depth + 1);
+    }
+    if (b->type == TOKEN_IS_FUNCTION && b->operator == '-') {
+        return rewrite(op == '+' ? '-' : '+', a, b->Left, depth + 1);
+        /*a + (-b) = a - b and a - (-b) = a + b*/
+    }
+    Node *merged = mergeTerms(op, a, b, depth);
+    if (merged != NULL) {
+        return merged;
+    }
+    if (a->type == TOKEN_IS_OPERATOR && (a->operator == '+' || a->operator == '-')) {
+        char sign = a->operator == '+' ? op : (op == '+' ? '-' : '+');
+        /*(p + q) + b, (p + q) - b, (p - q) + b, (p - q) - b: b meets q with this sign*/
+        Node *inner = mergeTerms(sign, a->Right, b, depth);
+        if (inner != NULL) {
+            return rewrite(a->operator, a->Left, inner, depth + 1);
+            /*like terms one level apart are brought together, the sum keeps the order of its terms*/
+        }
+        inner = mergeTerms(op, a->Left, b, depth);
+        if (inner != NULL) {
+            return rewrite(a->operator, inner, a->Right, depth + 1);
+        }
+    }
+    return plainNode(op, a, b);
+}
+
+static void splitPower(Node *node, Node **base, long long *exponent)
+/*node = base ^ exponent with an integer exponent, the exponent is 1 if there is none*/
+{
+    *base = node;
+    *exponent = 1;
+    long long value;
+    if (node->type == TOKEN_IS_OPERATOR && node->operator == '^' && constantValue(node->Right, &value)) {
+        *base = node->Left;
+        *exponent = value;
+    }
+}
+
+static Node *makePower(Node *base, long long exponent, int depth)
+{
+    if (exponent > INT_MAX || exponent < -(long long)INT_MAX) {
+        return NULL;
+    }
+    if (exponent < 0) {
+        return rewrite('/', constantNode(1), makePower(base, -exponent, depth + 1), depth + 1);
+    }
+    return rewrite('^', base, constantNode(exponent), depth + 1);
+}
+
+static Node *rewriteProduct(Node *a, Node *b, int depth)
+{
+    long long va, vb;
+    bool constantA = constantValue(a, &va), constantB = constantValue(b, &vb);
+    if (constantA && constantB) {
+        Node *folded = foldConstants('*', va, vb);
+        return folded != NULL ? folded : plainNode('*', a, b);
+    }
+    if ((constantA && va == 0) || (constantB && vb == 0)) {
+        return constantNode(0);
+        /*anything multiplied by zero is zero*/
+    }
+    if (constantA && va == 1) {
+        return b;
+    }
+    if (constantB && vb == 1) {
+        return a;
+    }
+    if (constantB) {
+        return rewrite('*', b, a, depth + 1);
+        /*the constant goes in front, so k * x and x * k are the same term*/
+    }
+    if (constantA && va == -1) {
+        return negate(b, depth + 1);
+    }
+    if (a->type == TOKEN_IS_FUNCTION && a->operator == '-') {
+        return negate(rewrite('*', a->Left, b, depth + 1), depth + 1);
+    }
+    if (b->type == TOKEN_IS_FUNCTION && b->operator == '-') {
+        return negate(rewrite('*', a, b->Left, depth + 1), depth + 1);
+    }
+    long long inner;
+    if (constantA && b->type == TOKEN_IS_OPERATOR && b->operator == '*' && constantValue(b->Left, &inner)) {
+        Node *folded = foldConstants('*', va, inner);
+        if (folded != NULL) {
+            return rewrite('*', folded, b->Right, depth + 1);
+            /*k * (m * x) = (k * m) * x*/
+        }
+    }
+    if (constantA && b->type == TOKEN_IS_OPERATOR && b->operator == '/' && isConstant(b->Left, 1)) {
+        return rewrite('/', a, b->Right, depth + 1);
+        /*k * (1 / x) = k / x*/
+    }
+    if (!constantA && a->type == TOKEN_IS_OPERATOR && a->operator == '*' && constantValue(a->Left, &inner)) {
+        return rewrite('*', a->Left, rewrite('*', a->Right, b, depth + 1), depth + 1);
+        /*(k * x) * y = k * (x * y), the constants of a product gather in front*/
+    }
+    if (!constantA && b->type == TOKEN_IS_OPERATOR && b->operator == '*' && constantValue(b->Left, &inner)) {
+        return rewrite('*', b->Left, rewrite('*', a, b->Right, depth + 1), depth + 1);
+    }
+    if (!constantA) {
+        Node *baseA, *baseB;
+        long long exponentA, exponentB;
+        splitPower(a, &baseA, &exponentA);
+        splitPower(b, &baseB, &exponentB);
+        if (baseA == baseB) {
+            Node *power = makePower(baseA, exponentA + exponentB, depth);
+            if (power != NULL) {
+                return power;
+                /*x ^ m * x ^ n = x ^ (m + n), and x * x = x ^ 2*/
+            }
+        }
+        if (b->type == TOKEN_IS_OPERATOR && b->operator == '/') {
+            return rewrite('/', rewrite('*', a, b->Left, depth + 1), b->Right, depth + 1);
+            /*a * (c / d) = (a * c) / d, so the division can meet what a has in common with d*/
+        }
+        if (a->type == TOKEN_IS_OPERATOR && a->operator == '/') {
+            return rewrite('/', rewrite('*', a->Left, b, depth + 1), a->Right, depth + 1);
+        }
+    }
+    return plainNode('*', a, b);
+}
+
+static Node *rewriteQuotient(Node *a, Node *b, int depth)
+{
+    long long va, vb;
+    bool constantA = constantValue(a, &va), constantB = constantValue(b, &vb);
+    if (constantA && constantB) {
+        Node *folded = foldConstants('/', va, vb);
+        return folded != NULL ? folded : plainNode('/', a, b);
+    }
+    if (constantA && va == 0) {
+        return a;
+        /*zero divided by anything (that is valid) is zero*/
+    }
+    if (constantB && vb == 1) {
+        return a;
+    }
+    if (constantB && vb == -1) {
+        return negate(a, depth + 1);
+    }
+    if (a == b) {
+        return constantNode(1);
+    }
+    if (a->type == TOKEN_IS_FUNCTION && a->operator == '-') {
+        return negate(rewrite('/', a->Left, b, depth + 1), depth + 1);
+    }
+    if (a->type == TOKEN_IS_OPERATOR && a->operator == '*' && (a->Left == b || a->Right == b)) {
+        return a->Left == b ? a->Right : a->Left;
+        /*(x * y) / y = x*/
+    }
+    long long coefficient;
+    if (a->type == TOKEN_IS_OPERATOR && a->operator == '*' && constantValue(a->Left, &coefficient)) {
+        return rewrite('*', a->Left, rewrite('/', a->Right, b, depth + 1), depth + 1);
+        /*(k * x) / y = k * (x / y), so x / y can cancel*/
+    }
+    if (!constantA && !constantB) {
+        Node *baseA, *baseB;
+        long long exponentA, exponentB;
+        splitPower(a, &baseA, &exponentA);
+        splitPower(b, &baseB, &exponentB);
+        if (baseA == baseB) {
+            Node *power = makePower(baseA, exponentA - exponentB, depth);
+            if (power != NULL) {
+                return power;
+                /*x ^ m / x ^ n = x ^ (m - n), which is what turns x ^ n * n / x into n * x ^ (n - 1)*/
+            }
+        }
+    }
+    return plainNode('/', a, b);
+}
+
+static Node *rewritePower(Node *a, Node *b, int depth)
+{
+    long long va, vb;
+    bool constantA = constantValue(a, &va), constantB = constantValue(b, &vb);
+    if (constantA && constantB) {
+        Node *folded = foldConstants('^', va, vb);
+        return folded != NULL ? folded : plainNode('^', a, b);
+    }
+    if (constantB && vb == 0) {
+        return constantNode(1);
+    }
+    if (constantB && vb == 1) {
+        return a;
+    }
+    if (constantA && va == 1) {
+        return a;
+    }
+    long long inner;
+    if (constantB && a->type == TOKEN_IS_OPERATOR && a->operator == '^' && constantValue(a->Right, &inner)) {
+        Node *power = makePower(a->Left, inner * vb, depth);
+        if (power != NULL) {
+            return power;
+            /*(x ^ m) ^ n = x ^ (m * n) for integer exponents*/
+        }
+    }
+    return plainNode('^', a, b);
+}
+
+static Node *rewrite(char op, Node *a, Node *b, int depth)
+/*a op b with the rules applied, its operands are simplified already*/
+{
+    if (a == NULL || b == NULL) {
+        return NULL;
+        /*a rule that could not build its result, the caller keeps what it had*/
+    }
+    if (depth >= SIMPLIFY_MAX_DEPTH) {
+        return plainNode(op, a, b);
+    }
+    switch (op) {
+        case '+':
+        case '-':
+            return rewriteSum(op, a, b, depth);
+        case '*':
+            return rewriteProduct(a, b, depth);
+        case '/':
+            return rewriteQuotient(a, b, depth);
+        case '^':
+            return rewritePower(a, b, depth);
+    }
+    return plainNode(op, a, b);
+}
+
+static Node *rewriteNode(Node *node, Node *left, Node *right)
+/*the simplified node, from its simplified operands*/
+{
+    Node *result = NULL;
+    if (node->type == TOKEN_IS_OPERATOR) {
+        result = rewrite(node->operator, left, right, 0);
+        if (result == NULL) {
+            result = plainNode(node->operator, left, right);
+        }
+    }
+    else if (node->type == TOKEN_IS_FUNCTION) {
+        if (node->operator == '-') {
+            result = negate(left, 0);
+        }
+        else if (isConstant(left, 1)) {
+            result = constantNode(0);
+            /*ln(1) = 0*/
+        }
+        else {
+            result = internNode(TOKEN_IS_FUNCTION, node->operator, 0, -1, left, NULL);
+        }
+    }
+    return result != NULL ? result : node;
+    /*numbers and variables are as simple as they get*/
+}
+
+static bool simplifyPass(Node **roots, int count)
+/*one bottom-up pass over every root, return whether anything changed*/
+{
+    int known = nodeStoreSize();
+    Node **done = (Node **)arenaCalloc(expressionArena(), known, sizeof(Node *));
+    /*the simplified node of every node that is there before the pass, the nodes the pass builds are not visited*/
+    int capacity = 64, top = 0;
+    Node **stack = (Node **)malloc(capacity * sizeof(Node *));
+    bool changed = false;
+    for (int i = 0; i < count; i++) {
+        stack[top++] = roots[i];
+        while (top > 0) {
+            Node *current = stack[top - 1];
+            if (done[current->id] != NULL) {
+                top--;
+                continue;
+                /*a shared subexpression is simplified once for every root*/
+            }
+            bool leftMissing = current->Left != NULL && done[current->Left->id] == NULL;
+            bool rightMissing = current->Right != NULL && done[current->Right->id] == NULL;
+            if (leftMissing || rightMissing) {
+                if (top + 2 > capacity) {
+                    capacity *= 2;
+                    stack = (Node **)realloc(stack, capacity * sizeof(Node *));
+                }
+                if (rightMissing) {
+                    stack[top++] = current->Right;
+                }
+                if (leftMissing) {
+                    stack[top++] = current->Left;
+                }
+                continue;
+            }
+            done[current->id] = rewriteNode(current, current->Left != NULL ? done[current->Left->id] : NULL,
+                                             current->Right != NULL ? done[current->Right->id] : NULL);
+            top--;
+        }
+        if (done[roots[i]->id] != roots[i]) {
+            roots[i] = done[roots[i]->id];
+            changed = true;
+        }
+    }
+    free(stack);
+    return changed;
+}
+
+void simplifyAll(Node **roots, int count)
+{
+    for (int pass = 0; pass < SIMPLIFY_MAX_PASSES && simplifyPass(roots, count); pass++) {
+        /*until a pass changes nothing, the rules only shrink the nodes so this ends after a few passes*/
+    }
+}
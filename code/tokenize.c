@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <limits.h>
+#include <string.h>
+#include "header.h"
+
+/*necessary header files included*/
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__) && defined(__SSE2__)
+#include <immintrin.h>
+#define TOKENIZE_SIMD
+#define TOKENIZE_DISPATCH
+/*GCC and Clang build the AVX2 and the SSE2 tokenizer, and the AVX2 one is used when the processor has it*/
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define TOKENIZE_SIMD
+#define TOKENIZE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TOKENIZE_SIMD
+#endif
+/*other compilers only have the widest instruction set the build targets, AVX2 with /arch:AVX2*/
+/*without SSE2 only the scalar tokenizer is built*/
+
+static void reserveTokens(TokenList *tokenListPtr, int extra)
+/*make room for extra more tokens, doubling the storage so that appending is amortized O(1)*/
+{
+    if (tokenListPtr->count + extra > tokenListPtr->capacity) {
+        int newCapacity = tokenListPtr->capacity ? tokenListPtr->capacity * 2 : TOKEN_INIT_NUM;
+        while (newCapacity < tokenListPtr->count + extra) {
+            newCapacity *= 2;
+        }
+        tokenListPtr->tokens = (Token *)realloc(tokenListPtr->tokens, newCapacity * sizeof(Token));
+        tokenListPtr->capacity = newCapacity;
+    }
+}
+
+static void storeToken(TokenList *tokenListPtr, char type, size_t offset, size_t length, int value)
+/*append one token into room that is already reserved*/
+{
+    Token *token = &tokenListPtr->tokens[tokenListPtr->count++];
+    token->type = type;
+    token->operator = type == TOKEN_IS_OPERATOR ? tokenListPtr->source[offset] : '\0';
+    token->length = (int)length;
+    token->offset = offset;
+    token->value = value;
+    /*only the position is stored, the characters stay in the expression*/
+}
+
+static void addToken(TokenList *tokenListPtr, char type, size_t offset, size_t length, int value)
+{
+    reserveTokens(tokenListPtr, 1);
+    storeToken(tokenListPtr, type, offset, length, value);
+}
+
+static int numberValue(char *text, size_t length)
+/*the value of a run of digits, -1 if it does not fit an int, which the parser rejects*/
+{
+    long value = 0;
+    for (size_t i = 0; i < length; i++) {
+        value = value * 10 + (text[i] - '0');
+        if (value > INT_MAX) {
+            return -1;
+            /*atoi() wrapped such numbers around, 2147483648 became -2147483648*/
+        }
+    }
+    return (int)value;
+}
+
+/*tokenize will help us separate the expression into different parts*/
+void tokenize(char *expression, TokenList *tokenListPtr) {
+    tokenizeRange(expression, strlen(expression), tokenListPtr);
+}
+
+void tokenizeScalar(char *expression, size_t expressionLength, TokenList *tokenListPtr) {
+    size_t i = 0, start = 0;
+    /*there are to pointers here, i is for the traversal of the entire expression*/
+    /*start is the first character of the token that is being read*/
+    tokenListPtr->source = expression;
+    tokenListPtr->count = 0;
+    /*initialize the count of all tokens, the storage is kept for reuse*/
+
+    while (i < expressionLength) {
+        if (isspace((unsigned char)expression[i])) {
+        /*if it is space, then skip*/
+            i++;
+            continue;
+        }
+
+        start = i;
+        /*start will be initialized for every token*/
+
+        if (isdigit((unsigned char)expression[i])) {
+            while (i < expressionLength && isdigit((unsigned char)expression[i])) {
+                i++;
+                /*note that the while loop here is for the storage of multi-bit numbers*/
+            }
+            addToken(tokenListPtr, TOKEN_IS_NUM, start, i - start, numberValue(expression + start, i - start));
+            /*if the type is number, then it will be stored*/
+        }
+        else if (isOperator(expression[i]) || expression[i] == '(' || expression[i] == ')') {
+            /*if the token is an operator or parentheses, it will also need to be stored*/
+            i++;
+            addToken(tokenListPtr, TOKEN_IS_OPERATOR, start, 1, 0);
+            /*store the operator type*/
+        }
+        else if (isalpha((unsigned char)expression[i]) || expression[i] == '_') {
+            /*store the variable type with C standard, which can start with letters of _*/
+            while (i < expressionLength && (isalnum((unsigned char)expression[i]) || expression[i] == '_')) {
+                /*the isalnum here is for the bits that can be numbers or letters*/
+                i++;
+            }
+            addToken(tokenListPtr, TOKEN_IS_VAR, start, i - start, 0);
+        }
+        else {
+            i++;
+            /*the case of other invalid inputs, we can directly skip the characters*/
+            continue;
+        }
+    }
+}
+
+const char *tokenizerName(void) {
+#if defined(TOKENIZE_DISPATCH)
+    return __builtin_cpu_supports("avx2") ? "AVX2" : "SSE2";
+#elif defined(TOKENIZE_AVX2)
+    return "AVX2";
+#elif defined(TOKENIZE_SIMD)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+#ifdef TOKENIZE_SIMD
+
+#define SIMD_BLOCK 64
+/*bytes that are classified together, one bit per byte in a 64 bit mask*/
+
+static int lowestBit(uint64_t mask)
+/*index of the lowest set bit, the mask is not zero*/
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+typedef struct CharMasks {
+    uint64_t digit;
+    /*0-9*/
+    uint64_t letter;
+    /*a-z, A-Z and _, the characters a name can start with*/
+    uint64_t operation;
+    /*+ - * / ^ ( ), every one of them is a token of its own*/
+} CharMasks;
+/*everything else, spaces included, is skipped in the same way as by the scalar tokenizer*/
+
+#if defined(TOKENIZE_DISPATCH)
+#define TOKENIZE_AVX2_TARGET __attribute__((target("avx2")))
+#define TOKENIZE_INLINE __attribute__((always_inline)) inline
+/*the loop is built once per instruction set, with the classifier of that set inlined into it*/
+#else
+#define TOKENIZE_AVX2_TARGET
+#define TOKENIZE_INLINE inline
+#endif
+
+#if defined(TOKENIZE_DISPATCH) || defined(TOKENIZE_AVX2)
+static TOKENIZE_AVX2_TARGET void classifyBlockAvx2(const char *block, CharMasks *masks)
+{
+    masks->digit = masks->letter = masks->operation = 0;
+    for (int half = 0; half < 2; half++) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(block + 32 * half));
+        __m256i lower = _mm256_or_si256(bytes, _mm256_set1_epi8(0x20));
+        /*the compares are signed, so the bytes from 0x80 up are below every range and never match*/
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), bytes));
+        __m256i letter = _mm256_or_si256(_mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower)),
+            _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('_')));
+        __m256i operation = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('+')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('-'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('*')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('/'))));
+        operation = _mm256_or_si256(operation, _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('^')),
+            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('(')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(')')))));
+        masks->digit |= (uint64_t)(uint32_t)_mm256_movemask_epi8(digit) << (32 * half);
+        masks->letter |= (uint64_t)(uint32_t)_mm256_movemask_epi8(letter) << (32 * half);
+        masks->operation |= (uint64_t)(uint32_t)_mm256_movemask_epi8(operation) << (32 * half);
+    }
+}
+#endif
+
+#if !defined(TOKENIZE_AVX2)
+static void classifyBlockSse2(const char *block, CharMasks *masks)
+{
+    masks->digit = masks->letter = masks->operation = 0;
+    for (int quarter = 0; quarter < 4; quarter++) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(block + 16 * quarter));
+        __m128i lower = _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+        /*the compares are signed, so the bytes from 0x80 up are below every range and never match*/
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(bytes, _mm_set1_epi8('9' + 1)));
+        __m128i letter = _mm_or_si128(_mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1))),
+            _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_')));
+        __m128i operation = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('+')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('-'))),
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('*')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('/'))));
+        operation = _mm_or_si128(operation, _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('^')),
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('(')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8(')')))));
+        masks->digit |= (uint64_t)(uint16_t)_mm_movemask_epi8(digit) << (16 * quarter);
+        masks->letter |= (uint64_t)(uint16_t)_mm_movemask_epi8(letter) << (16 * quarter);
+        masks->operation |= (uint64_t)(uint16_t)_mm_movemask_epi8(operation) << (16 * quarter);
+    }
+}
+#endif
+
+static bool isDigitChar(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static bool isNameChar(char c)
+{
+    return isDigitChar(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static size_t runLength(uint64_t run, int bit, char *expression, size_t base, size_t length, bool (*inRun)(char))
+/*length of the run of set bits from bit on, going on past the block with inRun() if it reaches the end*/
+{
+    uint64_t rest = ~(run >> bit);
+    if (bit > 0) {
+        rest &= ((uint64_t)1 << (SIMD_BLOCK - bit)) - 1;
+        /*only the bits that are still inside the block count*/
+    }
+    if (rest != 0) {
+        return (size_t)lowestBit(rest);
+    }
+    size_t end = base + SIMD_BLOCK;
+    while (end < length && inRun(expression[end])) {
+        end++;
+        /*a token across two blocks, rare enough for a plain loop*/
+    }
+    return end - (base + bit);
+}
+
+static int digitsValue(char *text, size_t length, size_t available)
+/*the value of up to eight digits in one 64 bit word, longer numbers are left to numberValue()*/
+{
+    if (length > 8) {
+        return numberValue(text, length);
+    }
+    uint64_t word = 0x3030303030303030ull;
+    memcpy(&word, text, available < 8 ? available : 8);
+    /*the bytes past the end of the expression are never read*/
+    word -= 0x3030303030303030ull;
+    word <<= 8 * (8 - length);
+    /*the digits move to the top bytes, the bytes below become zeros in front of the number*/
+    word = ((word & 0x0F0F0F0F0F0F0F0Full) * 2561) >> 8;
+    word = ((word & 0x00FF00FF00FF00FFull) * 6553601) >> 16;
+    word = ((word & 0x0000FFFF0000FFFFull) * 42949672960001ull) >> 32;
+    /*each step joins neighbouring groups of digits, 1 to 2, 2 to 4 and 4 to 8 digits*/
+    return (int)word;
+}
+
+static TOKENIZE_INLINE void tokenizeBlocks(char *expression, size_t expressionLength, TokenList *tokenListPtr,
+                                           void (*classifyBlock)(const char *, CharMasks *))
+{
+    tokenListPtr->source = expression;
+    tokenListPtr->count = 0;
+    uint64_t nameCarry = 0, numberCarry = 0;
+    /*whether the last byte of the previous block was part of a name, and part of a number*/
+    char padded[SIMD_BLOCK];
+    for (size_t base = 0; base < expressionLength; base += SIMD_BLOCK) {
+        const char *block = expression + base;
+        if (expressionLength - base < SIMD_BLOCK) {
+            memset(padded, 0, SIMD_BLOCK);
+            memcpy(padded, block, expressionLength - base);
+            block = padded;
+            /*the zeros of the last block belong to no class*/
+        }
+        CharMasks masks;
+        classifyBlock(block, &masks);
+        uint64_t name = masks.digit | masks.letter;
+        uint64_t afterName = (name << 1) | nameCarry;
+        uint64_t numberStart = masks.digit & ~afterName;
+        /*a number starts at a digit that does not follow a name character*/
+        uint64_t digitRuns = numberStart | (masks.digit & numberCarry);
+        uint64_t number = masks.digit & ~(masks.digit + digitRuns);
+        /*adding the starts carries through their runs of digits and clears them, the other digits belong to names*/
+        uint64_t afterNumber = (number << 1) | numberCarry;
+        uint64_t nameStart = masks.letter & (~afterName | afterNumber);
+        /*a name starts at a letter that follows no name character or the digits of a number, as in 2x*/
+        uint64_t starts = numberStart | nameStart | masks.operation;
+        reserveTokens(tokenListPtr, SIMD_BLOCK);
+        /*a block has at most one token per byte, so the room is checked once per block*/
+        while (starts != 0) {
+            int bit = lowestBit(starts);
+            starts &= starts - 1;
+            size_t offset = base + bit;
+            if ((masks.operation >> bit) & 1) {
+                storeToken(tokenListPtr, TOKEN_IS_OPERATOR, offset, 1, 0);
+            }
+            else if ((numberStart >> bit) & 1) {
+                size_t length = runLength(number, bit, expression, base, expressionLength, isDigitChar);
+                storeToken(tokenListPtr, TOKEN_IS_NUM, offset, length, digitsValue(expression + offset, length, expressionLength - offset));
+            }
+            else {
+                storeToken(tokenListPtr, TOKEN_IS_VAR, offset, runLength(name, bit, expression, base, expressionLength, isNameChar), 0);
+            }
+        }
+        nameCarry = name >> (SIMD_BLOCK - 1);
+        numberCarry = number >> (SIMD_BLOCK - 1);
+    }
+}
+
+#if defined(TOKENIZE_DISPATCH) || defined(TOKENIZE_AVX2)
+static TOKENIZE_AVX2_TARGET void tokenizeAvx2(char *expression, size_t expressionLength, TokenList *tokenListPtr)
+{
+    tokenizeBlocks(expression, expressionLength, tokenListPtr, classifyBlockAvx2);
+}
+#endif
+
+#if !defined(TOKENIZE_AVX2)
+static void tokenizeSse2(char *expression, size_t expressionLength, TokenList *tokenListPtr)
+{
+    tokenizeBlocks(expression, expressionLength, tokenListPtr, classifyBlockSse2);
+}
+#endif
+
+#endif
+
+void tokenizeRange(char *expression, size_t expressionLength, TokenList *tokenListPtr) {
+#if defined(TOKENIZE_DISPATCH)
+    if (__builtin_cpu_supports("avx2")) {
+        tokenizeAvx2(expression, expressionLength, tokenListPtr);
+    }
+    else {
+        tokenizeSse2(expression, expressionLength, tokenListPtr);
+    }
+#elif defined(TOKENIZE_AVX2)
+    tokenizeAvx2(expression, expressionLength, tokenListPtr);
+#elif defined(TOKENIZE_SIMD)
+    tokenizeSse2(expression, expressionLength, tokenListPtr);
+#else
+    tokenizeScalar(expression, expressionLength, tokenListPtr);
+#endif
+}
+
+void freeTokenList(TokenList *tokenListPtr) {
+    free(tokenListPtr->tokens);
+    memset(tokenListPtr, 0, sizeof(TokenList));
+    /*an all-zero tokenlist is a valid empty one*/
+}